@@ -0,0 +1,296 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+// Benchmarks of the buffer manager.
+// The scaling run has every thread pin and unpin random pages of one table that
+// fits in the pool, so the numbers show how the hit path scales with the number
+// of shards.  The policy run replays a mix of hot point lookups and large scans
+// against every replacement policy and reports the hit ratios.  The NUMA run
+// pins a thread to each node in turn and reads resident pages whose frames are
+// bound to each node, comparing local with remote memory.
+
+#include <stdlib.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+static const char *BENCH_FILENAME = "buffer_bench.tbl";
+static const char *SCAN_FILENAME = "buffer_bench_scan.tbl";
+
+static volatile unsigned long checksumSink;
+
+/**
+ * Pins and unpins random pages of the file until opsPerThread accesses are done.
+ */
+void worker(BufMgr *bufMgr, File *file, const std::vector<PageId> *pages,
+            unsigned seed, long opsPerThread)
+{
+    std::minstd_rand rng(seed);
+    Page *page;
+    for (long i = 0; i < opsPerThread; i++)
+    {
+        PageId pageNo = (*pages)[rng() % pages->size()];
+        bufMgr->readPage(file, pageNo, page);
+        bufMgr->unPinPage(file, pageNo, false);
+    }
+}
+
+/**
+ * Runs one configuration and returns the throughput in accesses per second.
+ */
+double run(File *file, const std::vector<PageId> &pages,
+           std::uint32_t numShards, unsigned numThreads, long opsPerThread)
+{
+    BufMgrOptions options;
+    options.numShards = numShards;
+    // leave every shard some slack so the whole table stays resident
+    BufMgr bufMgr(pages.size() * 2, options);
+
+    // warm the pool so the timed loop only exercises the hit path
+    Page *page;
+    for (size_t i = 0; i < pages.size(); i++)
+    {
+        bufMgr.readPage(file, pages[i], page);
+        bufMgr.unPinPage(file, pages[i], false);
+    }
+
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < numThreads; t++)
+        threads.push_back(std::thread(worker, &bufMgr, file, &pages, t + 1, opsPerThread));
+    for (unsigned t = 0; t < numThreads; t++)
+        threads[t].join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    bufMgr.flushFile(file);
+    return numThreads * opsPerThread / elapsed.count();
+}
+
+/**
+ * Replays hot lookups interleaved with full scans of a larger table and
+ * returns the statistics collected by the buffer manager.
+ */
+BufStats runMixed(File *hotFile, const std::vector<PageId> &hotPages,
+                  File *scanFile, const std::vector<PageId> &scanPages,
+                  ReplacementPolicyType policy, std::uint32_t numBufs, bool useRing)
+{
+    BufMgrOptions options;
+    options.policy = policy;
+    BufMgr bufMgr(numBufs, options);
+    BufAccessStrategy ring;
+
+    std::minstd_rand rng(42);
+    Page *page;
+    for (int round = 0; round < 20; round++)
+    {
+        for (int i = 0; i < 5000; i++)
+        {
+            // skewed lookups: half of them go to an eighth of the hot pages
+            size_t n = rng() % 2 ? hotPages.size() / 8 : hotPages.size();
+            PageId pageNo = hotPages[rng() % n];
+            bufMgr.readPage(hotFile, pageNo, page);
+            bufMgr.unPinPage(hotFile, pageNo, false);
+        }
+        for (size_t i = 0; i < scanPages.size(); i++)
+        {
+            bufMgr.readPage(scanFile, scanPages[i], page, useRing ? &ring : NULL);
+            bufMgr.unPinPage(scanFile, scanPages[i], false);
+        }
+    }
+    BufStats stats = bufMgr.getBufStats();
+    bufMgr.flushFile(hotFile);
+    bufMgr.flushFile(scanFile);
+    return stats;
+}
+
+#ifdef __linux__
+/**
+ * Restricts the calling thread to the CPUs of a NUMA node, returns false if it has none.
+ */
+bool pinToNode(int node)
+{
+    std::ostringstream path;
+    path << "/sys/devices/system/node/node" << node << "/cpulist";
+    std::ifstream cpulist(path.str().c_str());
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    bool any = false;
+    std::string range;
+    while (std::getline(cpulist, range, ','))
+    {
+        std::istringstream in(range);
+        int first, last;
+        char dash;
+        if (!(in >> first))
+            continue;
+        if (!(in >> dash >> last))
+            last = first;
+        for (int cpu = first; cpu <= last; cpu++)
+        {
+            CPU_SET(cpu, &cpus);
+            any = true;
+        }
+    }
+    return any && sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+}
+
+/**
+ * Reads every byte of the resident pages bound to memNode from a thread running
+ * on cpuNode and returns the nanoseconds per page access.
+ */
+double runNuma(BufMgr *bufMgr, File *file, const std::vector<PageId> &pages,
+               int cpuNode, int memNode, long opsPerThread)
+{
+    std::vector<PageId> local;
+    for (size_t i = 0; i < pages.size(); i++)
+        if (bufMgr->pageNode(file, pages[i]) == memNode)
+            local.push_back(pages[i]);
+    if (local.empty())
+        return 0;
+
+    double nsPerAccess = 0;
+    std::thread thread([&]() {
+        pinToNode(cpuNode);
+        std::minstd_rand rng(cpuNode * 31 + memNode);
+        Page *page;
+        unsigned long checksum = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (long i = 0; i < opsPerThread; i++)
+        {
+            PageId pageNo = local[rng() % local.size()];
+            bufMgr->readPage(file, pageNo, page);
+            const unsigned long *words = reinterpret_cast<const unsigned long *>(page);
+            for (size_t w = 0; w < sizeof(Page) / sizeof(unsigned long); w++)
+                checksum += words[w];
+            bufMgr->unPinPage(file, pageNo, false);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        nsPerAccess = elapsed.count() / opsPerThread;
+        // keeps the reads from being optimized away
+        checksumSink = checksum;
+    });
+    thread.join();
+    return nsPerAccess;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    unsigned maxThreads = argc > 1 ? atoi(argv[1]) : std::thread::hardware_concurrency();
+    long opsPerThread = argc > 2 ? atol(argv[2]) : 1000000;
+    unsigned numPages = 256;
+    if (maxThreads == 0)
+        maxThreads = 1;
+
+    if (File::exists(BENCH_FILENAME))
+        File::remove(BENCH_FILENAME);
+    std::vector<PageId> pages;
+    {
+        File file = File::create(BENCH_FILENAME);
+        for (unsigned i = 0; i < numPages; i++)
+            pages.push_back(file.allocatePage().page_number());
+
+        std::cout << "threads\tshards\taccesses/s" << std::endl;
+        for (unsigned threads = 1; threads <= maxThreads; threads *= 2)
+        {
+            std::uint32_t shardCounts[] = {1, 4 * threads};
+            for (int k = 0; k < 2; k++)
+            {
+                double throughput = run(&file, pages, shardCounts[k], threads, opsPerThread);
+                std::cout << threads << "\t" << shardCounts[k] << "\t"
+                          << std::fixed << std::setprecision(0) << throughput << std::endl;
+            }
+        }
+    }
+    File::remove(BENCH_FILENAME);
+
+    if (File::exists(SCAN_FILENAME))
+        File::remove(SCAN_FILENAME);
+    {
+        File hotFile = File::create(BENCH_FILENAME);
+        File scanFile = File::create(SCAN_FILENAME);
+        std::vector<PageId> hotPages, scanPages;
+        for (unsigned i = 0; i < 96; i++)
+            hotPages.push_back(hotFile.allocatePage().page_number());
+        for (unsigned i = 0; i < 512; i++)
+            scanPages.push_back(scanFile.allocatePage().page_number());
+
+        std::cout << std::endl
+                  << "policy\tscan ring\thit ratio (hot lookups + scans, 128 frames)" << std::endl;
+        ReplacementPolicyType policies[] = {CLOCK_POLICY, LRU_K_POLICY, TWO_Q_POLICY, ARC_POLICY};
+        for (int k = 0; k < 4; k++)
+        {
+            for (int ring = 0; ring < 2; ring++)
+            {
+                BufStats stats = runMixed(&hotFile, hotPages, &scanFile, scanPages, policies[k], 128, ring);
+                std::cout << stats.policy << "\t" << (ring ? "yes" : "no") << "\t"
+                          << std::setprecision(3) << stats.hitRatio() << std::endl;
+            }
+        }
+    }
+    File::remove(BENCH_FILENAME);
+    File::remove(SCAN_FILENAME);
+
+#ifdef __linux__
+    std::vector<int> nodes = BufMgr::numaNodes();
+    std::cout << std::endl;
+    if (nodes.size() < 2)
+    {
+        std::cout << "single NUMA node, no remote memory to compare" << std::endl;
+        return 0;
+    }
+    if (File::exists(BENCH_FILENAME))
+        File::remove(BENCH_FILENAME);
+    {
+        File file = File::create(BENCH_FILENAME);
+        std::vector<PageId> numaPages;
+        // large enough to not fit in the last level cache
+        for (unsigned i = 0; i < 16384; i++)
+            numaPages.push_back(file.allocatePage().page_number());
+
+        BufMgrOptions options;
+        options.numaAware = true;
+        BufMgr bufMgr(numaPages.size() * 2, options);
+        Page *page;
+        for (size_t i = 0; i < numaPages.size(); i++)
+        {
+            bufMgr.readPage(&file, numaPages[i], page);
+            bufMgr.unPinPage(&file, numaPages[i], false);
+        }
+
+        std::cout << "cpu node\tmemory node\tns/page (8KB read)" << std::endl;
+        for (size_t c = 0; c < nodes.size(); c++)
+        {
+            for (size_t m = 0; m < nodes.size(); m++)
+            {
+                double ns = runNuma(&bufMgr, &file, numaPages, nodes[c], nodes[m], opsPerThread / 10);
+                std::cout << nodes[c] << "\t" << nodes[m] << (c == m ? " (local)" : " (remote)") << "\t"
+                          << std::fixed << std::setprecision(1) << ns << std::endl;
+            }
+        }
+        bufMgr.flushFile(&file);
+    }
+    File::remove(BENCH_FILENAME);
+#endif
+    return 0;
+}
@@ -0,0 +1,206 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+// BufFlatHashTbl类使用线性探测的开放寻址实现页表，插入和删除不会分配内存。
+#include "bufFlatHashTbl.h"
+#include "exceptions/hash_already_present_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/hash_table_exception.h"
+
+namespace badgerdb
+{
+std::uint32_t BufFlatHashTbl::hash(const FileId fileId, const PageId pageNo) const
+{
+    std::uint64_t key = ((std::uint64_t)fileId << 32) | pageNo;
+    // multiplicative hashing spreads consecutive page numbers over the table
+    key *= 0x9E3779B97F4A7C15ULL;
+    return (std::uint32_t)(key >> 32) & mask;
+}
+
+BufFlatHashTbl::BufFlatHashTbl(const std::uint32_t maxEntries)
+    : numEntries(0), draining(NULL), drainCursor(0)
+{
+    allocate(maxEntries);
+}
+
+BufFlatHashTbl::~BufFlatHashTbl()
+{
+    delete draining;
+    delete[] slots;
+}
+
+void BufFlatHashTbl::allocate(const std::uint32_t maxEntries)
+{
+    this->maxEntries = maxEntries;
+    // keep the load factor at or below one half
+    capacity = 2;
+    while (capacity < 2 * maxEntries)
+        capacity <<= 1;
+    mask = capacity - 1;
+
+    slots = new flatHashSlot[capacity];
+    for (std::uint32_t i = 0; i < capacity; i++)
+        slots[i].fileId = File::INVALID_ID;
+}
+
+std::uint32_t BufFlatHashTbl::find(const FileId fileId, const PageId pageNo) const
+{
+    std::uint32_t index = hash(fileId, pageNo);
+    // the table is never full, so every probe run ends at an empty slot
+    while (slots[index].fileId != File::INVALID_ID)
+    {
+        if (slots[index].fileId == fileId && slots[index].pageNo == pageNo)
+            return index;
+        index = (index + 1) & mask;
+    }
+    return capacity;
+}
+
+void BufFlatHashTbl::insert(const File *file, const PageId pageNo, const FrameId frameNo)
+{
+    if (!tryInsert(file, pageNo, frameNo))
+    {
+        FrameId present = 0;
+        tryLookup(file, pageNo, present);
+        throw HashAlreadyPresentException(file->filename(), pageNo, present);
+    }
+}
+
+void BufFlatHashTbl::lookup(const File *file, const PageId pageNo, FrameId &frameNo)
+{
+    if (!tryLookup(file, pageNo, frameNo))
+        throw HashNotFoundException(file->filename(), pageNo);
+}
+
+void BufFlatHashTbl::remove(const File *file, const PageId pageNo)
+{
+    if (!tryRemove(file, pageNo))
+        throw HashNotFoundException(file->filename(), pageNo);
+}
+
+bool BufFlatHashTbl::place(const FileId fileId, const PageId pageNo, const FrameId frameNo)
+{
+    std::uint32_t index = hash(fileId, pageNo);
+    while (slots[index].fileId != File::INVALID_ID)
+    {
+        if (slots[index].fileId == fileId && slots[index].pageNo == pageNo)
+            return false;
+        index = (index + 1) & mask;
+    }
+    slots[index].fileId = fileId;
+    slots[index].pageNo = pageNo;
+    slots[index].frameNo = frameNo;
+    numEntries++;
+    return true;
+}
+
+bool BufFlatHashTbl::tryInsert(const File *file, const PageId pageNo, const FrameId frameNo)
+{
+    const FileId fileId = file->id();
+    rehash(REHASH_STEPS);
+    std::uint32_t pending = 0;
+    if (draining != NULL)
+    {
+        if (draining->find(fileId, pageNo) != draining->capacity)
+            return false;
+        pending = draining->numEntries;
+    }
+    if (find(fileId, pageNo) != capacity)
+        return false;
+    if (numEntries + pending == maxEntries)
+        throw HashTableException();
+    return place(fileId, pageNo, frameNo);
+}
+
+bool BufFlatHashTbl::tryLookup(const File *file, const PageId pageNo, FrameId &frameNo) const
+{
+    std::uint32_t index = find(file->id(), pageNo);
+    if (index == capacity)
+        return draining != NULL && draining->tryLookup(file, pageNo, frameNo);
+    frameNo = slots[index].frameNo; // return frameNo by reference
+    return true;
+}
+
+bool BufFlatHashTbl::tryRemove(const File *file, const PageId pageNo)
+{
+    rehash(REHASH_STEPS);
+    std::uint32_t hole = find(file->id(), pageNo);
+    if (hole == capacity)
+        return draining != NULL && draining->tryRemove(file, pageNo);
+    removeAt(hole);
+    return true;
+}
+
+void BufFlatHashTbl::removeAt(std::uint32_t hole)
+{
+    // Backward shift deletion: walk the rest of the probe run and move every
+    // entry that may legally live in the hole into it, then continue from the
+    // slot it left behind.
+    std::uint32_t next = hole;
+    while (true)
+    {
+        next = (next + 1) & mask;
+        if (slots[next].fileId == File::INVALID_ID)
+            break;
+        std::uint32_t home = hash(slots[next].fileId, slots[next].pageNo);
+        // distance from home to next must cover the hole for the move to be valid
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            slots[hole] = slots[next];
+            hole = next;
+        }
+    }
+    slots[hole].fileId = File::INVALID_ID;
+    numEntries--;
+}
+
+void BufFlatHashTbl::rehash(std::uint32_t steps)
+{
+    while (draining != NULL && steps > 0)
+    {
+        if (draining->numEntries == 0)
+        {
+            delete draining;
+            draining = NULL;
+            break;
+        }
+        // every slot below the cursor is empty, so the backward shift of
+        // removeAt() only moves entries that are still ahead of it
+        const flatHashSlot slot = draining->slots[drainCursor];
+        if (slot.fileId == File::INVALID_ID)
+            drainCursor++;
+        else
+        {
+            place(slot.fileId, slot.pageNo, slot.frameNo);
+            draining->removeAt(drainCursor);
+        }
+        steps--;
+    }
+}
+
+void BufFlatHashTbl::resize(const std::uint32_t maxEntries)
+{
+    // finish the previous resize first, at most two slot arrays exist at a time
+    while (draining != NULL)
+        rehash(capacity);
+    if (numEntries > maxEntries)
+        throw HashTableException();
+
+    // the current slots become the table being drained
+    draining = new BufFlatHashTbl(0);
+    delete[] draining->slots;
+    draining->slots = slots;
+    draining->capacity = capacity;
+    draining->mask = mask;
+    draining->maxEntries = this->maxEntries;
+    draining->numEntries = numEntries;
+    drainCursor = 0;
+
+    numEntries = 0;
+    allocate(maxEntries);
+}
+
+} // namespace badgerdb
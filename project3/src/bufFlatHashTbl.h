@@ -0,0 +1,220 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include "file.h"
+
+namespace badgerdb
+{
+
+/**
+* @brief One slot of the open addressing page table
+*/
+struct flatHashSlot
+{
+    /**
+	 * id of the file the page belongs to, File::INVALID_ID if the slot is empty
+	 */
+    FileId fileId;
+
+    /**
+	 * page number within a file
+	 */
+    PageId pageNo;
+
+    /**
+	 * frame number of page in the buffer pool
+	 */
+    FrameId frameNo;
+};
+
+/**
+* @brief Open addressing hash table to keep track of pages in the buffer pool
+*
+* Replaces the chained BufHashTbl of the original BadgerDB.  All slots live in
+* one flat array that is allocated once in the constructor, so insert() and
+* remove() never touch the heap.  Collisions are resolved by linear probing and
+* entries are deleted by shifting the rest of their probe run backwards, so no
+* tombstones build up.
+* The table holds at most one entry per buffer frame and is sized to stay at
+* most half full.
+*
+* resize() does not rehash at once: the old slot array is kept next to the new
+* one and drained a few slots at a time by later insertions and removals, so
+* growing or shrinking the pool never stalls a shard for a full rehash.
+*
+* @warning This class is not threadsafe.
+*/
+class BufFlatHashTbl
+{
+private:
+    /**
+	 *	Number of slots, always a power of two
+	 */
+    std::uint32_t capacity;
+
+    /**
+	 *	capacity - 1, used to wrap slot indexes
+	 */
+    std::uint32_t mask;
+
+    /**
+	 *	Maximum number of entries the table accepts
+	 */
+    std::uint32_t maxEntries;
+
+    /**
+	 *	Number of entries currently in the table
+	 */
+    std::uint32_t numEntries;
+
+    /**
+	 * Actual slot array
+	 */
+    flatHashSlot *slots;
+
+    /**
+	 * Table being drained into this one after resize(), NULL if no rehash is in progress
+	 */
+    BufFlatHashTbl *draining;
+
+    /**
+	 * Slots of draining below this index are empty
+	 */
+    std::uint32_t drainCursor;
+
+    /**
+	 * Allocates an empty slot array for at most maxEntries entries
+	 */
+    void allocate(const std::uint32_t maxEntries);
+
+    /**
+	 * returns the home slot between 0 and capacity-1 computed using file id and pageNo
+	 *
+	 * @param fileId 	File id
+	 * @param pageNo  Page number in the file
+	 * @return  			Slot index.
+	 */
+    std::uint32_t hash(const FileId fileId, const PageId pageNo) const;
+
+    /**
+	 * returns the index of the slot holding (fileId, pageNo), or capacity if absent
+	 *
+	 * @param fileId 	File id
+	 * @param pageNo  Page number in the file
+	 */
+    std::uint32_t find(const FileId fileId, const PageId pageNo) const;
+
+    /**
+	 * Inserts an entry into this slot array without looking at draining
+	 *
+	 * @return  			False if the page was already present.
+	 */
+    bool place(const FileId fileId, const PageId pageNo, const FrameId frameNo);
+
+    /**
+	 * Empties the slot at index by backward shift deletion
+	 */
+    void removeAt(std::uint32_t hole);
+
+    /**
+	 * Moves up to steps slots of draining into this table, frees it once empty
+	 */
+    void rehash(std::uint32_t steps);
+
+public:
+    /**
+   * Constructor of BufFlatHashTbl class
+	 *
+	 * @param maxEntries  Maximum number of entries, normally the number of buffer frames
+	 */
+    BufFlatHashTbl(const std::uint32_t maxEntries);
+
+    /**
+   * Destructor of BufFlatHashTbl class
+	 */
+    ~BufFlatHashTbl();
+
+    /**
+   * Insert entry into hash table mapping (file, pageNo) to frameNo.
+	 *
+	 * @param file   	File object
+	 * @param pageNo 	Page number in the file
+	 * @param frameNo Frame number assigned to that page of the file
+   * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
+   * @throws  HashTableException if the table already holds maxEntries entries
+	 */
+    void insert(const File *file, const PageId pageNo, const FrameId frameNo);
+
+    /**
+   * Check if (file, pageNo) is currently in the buffer pool (ie. in
+   * the hash table).
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference
+   * @throws HashNotFoundException if the page entry is not found in the hash table 
+	 */
+    void lookup(const File *file, const PageId pageNo, FrameId &frameNo);
+
+    /**
+   * Delete entry (file,pageNo) from hash table.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+   * @throws HashNotFoundException if the page entry is not found in the hash table 
+	 */
+    void remove(const File *file, const PageId pageNo);
+
+    /**
+   * Insert entry into hash table mapping (file, pageNo) to frameNo unless the
+   * page is already present.  Never throws for a present entry.
+	 *
+	 * @param file   	File object
+	 * @param pageNo 	Page number in the file
+	 * @param frameNo Frame number assigned to that page of the file
+	 * @return  			True if inserted, false if the page was already present.
+   * @throws  HashTableException if the table already holds maxEntries entries
+	 */
+    bool tryInsert(const File *file, const PageId pageNo, const FrameId frameNo);
+
+    /**
+   * Check if (file, pageNo) is currently in the hash table without throwing.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference, only set when found
+	 * @return  			True if found.
+	 */
+    bool tryLookup(const File *file, const PageId pageNo, FrameId &frameNo) const;
+
+    /**
+   * Delete entry (file,pageNo) from hash table if present.  Never throws.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			True if an entry was removed.
+	 */
+    bool tryRemove(const File *file, const PageId pageNo);
+
+    /**
+   * Changes the maximum number of entries.  The entries are moved over to the
+   * new slot array incrementally by the following insertions and removals.
+	 *
+	 * @param maxEntries  New maximum number of entries
+   * @throws  HashTableException if the table holds more than maxEntries entries
+	 */
+    void resize(const std::uint32_t maxEntries);
+
+    /**
+   * Number of slots moved per insertion or removal while a resize is in progress
+	 */
+    static const std::uint32_t REHASH_STEPS = 4;
+};
+
+} // namespace badgerdb
@@ -8,186 +8,1474 @@
 
 #include <memory>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/buffer_budget_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
-#include "exceptions/hash_not_found_exception.h"
 
 namespace badgerdb
 {
 
-BufMgr::BufMgr(std::uint32_t bufs) : numBufs(bufs)
+BufMgr::BufMgr(std::uint32_t bufs, const BufMgrOptions &options)
+	: numBufs(bufs), options(options), reservedFrames(0), writerStop(false), readAheadFile(File::INVALID_ID),
+	  readAheadMisses(0), readAheadStop(false), warmFile(File::INVALID_ID), warmLoads(0), warming(false),
+	  warmStop(false)
 {
-	bufDescTable = new BufDesc[bufs]; //建立起bufs大小的缓冲池
+	std::vector<int> nodes;
+	if (options.numaAware)
+		nodes = numaNodes();
+	if (nodes.size() < 2)
+		nodes.clear();
 
-	for (FrameId i = 0; i < bufs; i++)
+	// every shard needs at least one frame
+	numShards = options.numShards;
+	if (numShards < nodes.size())
+		numShards = nodes.size();
+	if (numShards == 0)
+		numShards = 1;
+	if (numShards > bufs)
+		numShards = bufs;
+	// each shard gets a stripe of frames it can grow into
+	const std::uint32_t maxBufs = std::max(options.maxBufs, bufs);
+	framesPerShard = (maxBufs + numShards - 1) / numShards;
+	const std::uint32_t totalFrames = numShards * framesPerShard;
+
+	bufDescTable = new BufDesc[totalFrames]; //建立起bufs大小的缓冲池
+
+	for (FrameId i = 0; i < totalFrames; i++)
 	{
 		bufDescTable[i].frameNo = i;
-		bufDescTable[i].valid = false;
 	}
 
-	bufPool = new Page[bufs];
+	// one aligned arena for all frames instead of a heap block per page
+	std::size_t alignment = FRAME_ALIGNMENT;
+	std::size_t arenaSize = (std::size_t)totalFrames * sizeof(Page);
+	if (options.hugePages)
+	{
+		alignment = HUGE_PAGE_SIZE;
+		arenaSize = (arenaSize + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+	}
+	void *arena;
+	if (posix_memalign(&arena, alignment, arenaSize) != 0)
+		throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+	if (options.hugePages)
+		madvise(arena, arenaSize, MADV_HUGEPAGE);
+#endif
+	bufPool = static_cast<Page *>(arena);
+
+	shards = new BufShard[numShards];
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		BufShard &shard = shards[s];
+		shard.firstFrame = s * framesPerShard;
+		shard.numFrames = shardSize(s, bufs);
+		// the whole stripe is bound before its first frame is touched, frames added by resize() follow
+		shard.numaNode = -1;
+		if (!nodes.empty() && bindToNode(&bufPool[shard.firstFrame], (std::size_t)framesPerShard * sizeof(Page),
+										 nodes[s % nodes.size()]))
+			shard.numaNode = nodes[s % nodes.size()];
+		// only frames in use are touched, the rest of the stripe stays uncommitted
+		for (std::uint32_t i = 0; i < shard.numFrames; i++)
+			new (&bufPool[shard.firstFrame + i]) Page();
+
+		// the page table holds at most one entry per frame of the shard
+		shard.hashTable = new BufFlatHashTbl(shard.numFrames);
 
-	int htsize = ((((int)(bufs * 1.2)) * 2) / 2) + 1;
-	hashTable = new BufHashTbl(htsize); // allocate the buffer hash table
+		shard.policy = ReplacementPolicy::create(options.policy, bufDescTable, shard.firstFrame,
+												 shard.numFrames, options.lruK);
 
-	clockHand = bufs - 1;
+		// hand out frames in ascending order
+		for (std::uint32_t i = shard.numFrames; i > 0; i--)
+			shard.freeFrames.push_back(shard.firstFrame + i - 1);
+		shard.bufStats.policy = shard.policy->name();
+	}
+
+	if (options.backgroundWriter)
+		writer = std::thread(&BufMgr::writerLoop, this);
+	if (options.readAheadPages)
+		prefetcher = std::thread(&BufMgr::prefetcherLoop, this);
+	if (!options.warmStartFile.empty())
+	{
+		warming = true;
+		warmer = std::thread(&BufMgr::warmUp, this, options.warmStartFile);
+	}
 }
 
 BufMgr::~BufMgr()
 {
-	for (FrameId i = 0; i < numBufs; i++)
+	if (prefetcher.joinable())
 	{
-		if (bufDescTable[i].dirty == true)
 		{
-			flushFile(bufDescTable[i].file);
+			std::lock_guard<std::mutex> lock(readAheadLatch);
+			readAheadStop = true;
 		}
+		readAheadWakeup.notify_one();
+		prefetcher.join();
 	}
+	if (writer.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(writerMutex);
+			writerStop = true;
+		}
+		writerWakeup.notify_one();
+		writer.join();
+	}
+	if (warmer.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(warmLatch);
+			warmStop = true;
+		}
+		warmer.join();
+	}
+	// saved before the flushes below empty the pool
+	if (!options.warmStartFile.empty())
+		savePageSet(options.warmStartFile);
+
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		for (FrameId i = shards[s].firstFrame; i < shards[s].firstFrame + shards[s].numFrames; i++)
+		{
+			if (bufDescTable[i].testFlags(BufDesc::DIRTY))
+			{
+				flushFile(bufDescTable[i].file);
+			}
+		}
+	}
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		delete shards[s].hashTable;
+		delete shards[s].policy;
+	}
+	delete[] shards;
 	delete[] bufDescTable;
-	delete[] bufPool;
-	delete hashTable;
+	for (std::map<FileId, File *>::iterator it = warmFiles.begin(); it != warmFiles.end(); ++it)
+		delete it->second;
+	for (std::map<FileId, File *>::iterator it = readAheadFiles.begin(); it != readAheadFiles.end(); ++it)
+		delete it->second;
+	// pages are trivially destructible
+	free(bufPool);
 }
 
-void BufMgr::advanceClock()
+BufShard &BufMgr::shardFor(const File *file, const PageId pageNo)
 {
-	clockHand++;
-	clockHand %= numBufs;
+	if (numShards == 1)
+		return shards[0];
+	// consecutive pages of a file land in different shards.  The shard is taken from the
+	// top bits of the hash, the page table of the shard indexes with the low bits
+	// (BufFlatHashTbl::hash()), so the pages of a shard still use all of its slots.
+	std::uint64_t key = ((std::uint64_t)file->id() << 32) | pageNo;
+	key *= 0x9E3779B97F4A7C15ULL;
+	return shards[((key >> 32) * numShards) >> 32];
 }
 
-void BufMgr::allocBuf(FrameId &frame)
+std::uint64_t BufMgr::elapsedNs(const IOClock::time_point start)
 {
-	unsigned count = 0;
-	for (unsigned j = 0; j < numBufs; j++)
-		if (bufDescTable[j].pinCnt != 0)
-			count++;
-	if (count == numBufs)
-		throw BufferExceededException();
-	while (1)
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(IOClock::now() - start).count();
+}
+
+void BufMgr::countReads(BufShard &shard, const FileId fileId, const std::uint32_t pages, const std::uint64_t ns)
+{
+	shard.bufStats.diskreads += pages;
+	shard.bufStats.fileIO[fileId].reads += pages;
+	shard.bufStats.readLatency.record(ns);
+}
+
+void BufMgr::countWrites(BufShard &shard, const FileId fileId, const std::uint32_t pages, const std::uint64_t ns)
+{
+	shard.bufStats.diskwrites += pages;
+	shard.bufStats.fileIO[fileId].writes += pages;
+	shard.bufStats.writeLatency.record(ns);
+}
+
+BufShard &BufMgr::shardOf(const FrameId frame)
+{
+	return shards[frame / framesPerShard];
+}
+
+std::vector<int> BufMgr::numaNodes()
+{
+	std::vector<int> nodes;
+	// a list of ranges such as "0-1,3"
+	std::ifstream online("/sys/devices/system/node/online");
+	std::string range;
+	while (std::getline(online, range, ','))
 	{
-		advanceClock();
-		BufDesc* nowDesc =  &bufDescTable[clockHand];
-		if (nowDesc->valid == false)
-		{
-			frame = clockHand;
+		std::istringstream in(range);
+		int first, last;
+		char dash;
+		if (!(in >> first))
+			continue;
+		if (!(in >> dash >> last))
+			last = first;
+		for (int node = first; node <= last; node++)
+			nodes.push_back(node);
+	}
+	return nodes;
+}
+
+bool BufMgr::bindToNode(void *addr, const std::size_t length, const int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+	// mbind() is called directly so the build does not need libnuma
+	const int MPOL_PREFERRED_MODE = 1;
+	unsigned long nodemask[16] = {0};
+	const int bits = 8 * sizeof(unsigned long);
+	if (node < 0 || node >= 16 * bits)
+		return false;
+	nodemask[node / bits] = 1UL << (node % bits);
+	return syscall(SYS_mbind, addr, length, MPOL_PREFERRED_MODE, nodemask, 16 * bits + 1, 0) == 0;
+#else
+	return false;
+#endif
+}
+
+int BufMgr::pageNode(const File *file, const PageId pageNo)
+{
+	return shardFor(file, pageNo).numaNode;
+}
+
+std::uint32_t BufMgr::shardSize(const std::uint32_t s, const std::uint32_t bufs) const
+{
+	return bufs / numShards + (s < bufs % numShards ? 1 : 0);
+}
+
+void BufMgr::writerLoop()
+{
+	std::unique_lock<std::mutex> lock(writerMutex);
+	while (!writerStop)
+	{
+		writerWakeup.wait_for(lock, std::chrono::milliseconds(options.writerIntervalMs));
+		if (writerStop)
 			break;
+		lock.unlock();
+		std::uint32_t budget = options.writerBatchPages;
+		for (std::uint32_t s = 0; s < numShards && budget > 0; s++)
+			budget -= writeAhead(shards[s], budget);
+		lock.lock();
+	}
+}
+
+std::uint32_t BufMgr::writeAhead(BufShard &shard, const std::uint32_t max)
+{
+	std::vector<FrameId> candidates;
+	std::vector<FrameId> frames;
+	std::vector<Page> copies;
+	{
+		std::lock_guard<std::mutex> guard(shard.latch);
+		// nothing will be evicted while free frames are left
+		if (!shard.freeFrames.empty())
+			return 0;
+		shard.policy->peekVictims(options.writerLookahead, candidates);
+		for (std::size_t i = 0; i < candidates.size() && frames.size() < max; i++)
+		{
+			BufDesc *nowDesc = &bufDescTable[candidates[i]];
+			if (!nowDesc->testFlags(BufDesc::VALID) || !nowDesc->testFlags(BufDesc::DIRTY) || nowDesc->pinCount())
+				continue;
+			// the copy is taken while nobody holds the page; whoever pins it
+			// during the write dirties it again when unpinning
+			nowDesc->setFlags(BufDesc::WRITE_IN_PROGRESS);
+			nowDesc->clearFlags(BufDesc::DIRTY);
+			frames.push_back(candidates[i]);
+			copies.push_back(bufPool[candidates[i]]);
+		}
+		shard.numWriting += frames.size();
+	}
+	if (frames.empty())
+		return 0;
+
+	std::vector<bool> written(frames.size(), false);
+	std::vector<std::uint64_t> latencies(frames.size(), 0);
+	for (std::size_t i = 0; i < frames.size(); i++)
+	{
+		try
+		{
+			const IOClock::time_point start = IOClock::now();
+			bufDescTable[frames[i]].file->writePage(copies[i]);
+			latencies[i] = elapsedNs(start);
+			written[i] = true;
 		}
-		if (nowDesc->refbit == false)
+		catch (...)
 		{
-			if (nowDesc->pinCnt == 0)
+			// leave the page dirty, the foreground write reports the error
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(shard.latch);
+		for (std::size_t i = 0; i < frames.size(); i++)
+		{
+			BufDesc *nowDesc = &bufDescTable[frames[i]];
+			nowDesc->clearFlags(BufDesc::WRITE_IN_PROGRESS);
+			if (written[i])
 			{
-				if (nowDesc->dirty == true)
-				{
-					nowDesc->file->writePage(bufPool[clockHand]);
-					nowDesc->dirty = false;
-				}
-				frame = clockHand;
-				try
-				{
-					hashTable->remove(nowDesc->file, nowDesc->pageNo);
-				}
-				catch (HashNotFoundException &)
-				{
-				}
-				break;
+				countWrites(shard, nowDesc->fileId, 1, latencies[i]);
+				shard.bufStats.writerWrites++;
 			}
+			else
+				nowDesc->setFlags(BufDesc::DIRTY);
 		}
-		else nowDesc->refbit = false;
+		shard.numWriting -= frames.size();
 	}
+	shard.ioDone.notify_all();
+	return frames.size();
 }
 
-void BufMgr::readPage(File *file, const PageId pageNo, Page *&page)
+void BufMgr::prefetcherLoop()
 {
-	FrameId frame;
-	try
+	std::unique_lock<std::mutex> lock(readAheadLatch);
+	while (true)
+	{
+		while (!readAheadStop && readAheadQueue.empty())
+			readAheadWakeup.wait(lock);
+		if (readAheadStop)
+			break;
+		ReadAheadRequest request = readAheadQueue.front();
+		readAheadQueue.pop_front();
+		readAheadFile = request.file->id();
+		lock.unlock();
+		readAhead(request);
+		lock.lock();
+		readAheadFile = File::INVALID_ID;
+		readAheadDone.notify_all();
+	}
+}
+
+void BufMgr::readAhead(const ReadAheadRequest &request)
+{
+	File *file = request.file;
+	PageId pageNo = request.first;
+	if (request.count == 0)
+	{
+		try
+		{
+			file->nextUsedPage(pageNo);
+		}
+		catch (...)
+		{
+			// the file goes without read-ahead
+		}
+		return;
+	}
+	for (std::uint32_t i = 0; i < request.count && pageNo != Page::INVALID_NUMBER; i++)
+	{
+		BufShard &shard = shardFor(file, pageNo);
+		std::unique_lock<std::mutex> guard(shard.latch);
+		FrameId frame;
+		if (shard.hashTable->tryLookup(file, pageNo, frame))
+		{
+			// somebody else is reading the page, the scan is ahead of the read-ahead
+			if (bufDescTable[frame].testFlags(BufDesc::READ_IN_PROGRESS))
+				return;
+			guard.unlock();
+			pageNo = file->nextUsedPage(pageNo);
+			continue;
+		}
+		// read-ahead only fills free frames, it never evicts
+		if (shard.freeFrames.empty())
+			return;
+		frame = shard.freeFrames.back();
+		shard.freeFrames.pop_back();
+		loadFrame(shard, frame, file, pageNo);
+		bufDescTable[frame].setFlags(BufDesc::READ_IN_PROGRESS);
+		guard.unlock();
+		std::uint64_t ns;
+		try
+		{
+			const IOClock::time_point start = IOClock::now();
+			file->readPageInto(pageNo, bufPool[frame]);
+			ns = elapsedNs(start);
+		}
+		catch (...)
+		{
+			// the page may have been deleted meanwhile, the scan reports it if it gets there
+			guard.lock();
+			finishRead(shard, frame, false);
+			return;
+		}
+		guard.lock();
+		finishRead(shard, frame, true);
+		unpinFrame(shard, frame, false);
+		bufDescTable[frame].prefetched = true;
+		countReads(shard, file->id(), 1, ns);
+		shard.bufStats.readAheadReads++;
+		guard.unlock();
+		pageNo = file->nextUsedPage(pageNo);
+	}
+}
+
+void BufMgr::noteRead(File *file, const PageId pageNo, const bool miss)
+{
+	std::lock_guard<std::mutex> lock(readAheadLatch);
+	ReadAheadState &state = readAheadStates[file->id()];
+	// only a miss starts a run, other hits need not look at the chain
+	if (!miss && !state.hinted && pageNo != state.expected)
 	{
-		hashTable->lookup(file, pageNo, frame);
-		bufDescTable[frame].pinCnt++;
-		bufDescTable[frame].refbit = true;
+		state.run = 0;
+		state.untilRequest = 0;
+		state.expected = Page::INVALID_NUMBER;
+		return;
 	}
-	catch (HashNotFoundException &)
+	// the next page number in the frame may be stale, the file knows the chain;
+	// reading it from disk is left to the read-ahead thread
+	PageId nextPageNo;
+	if (!file->tryNextUsedPage(pageNo, nextPageNo))
 	{
-		allocBuf(frame);
-		bufPool[frame] = file->readPage(pageNo);
-		hashTable->insert(file, pageNo, frame);
-		bufDescTable[frame].Set(file, pageNo);
+		if (!state.listRequested)
+		{
+			state.listRequested = true;
+			queueReadAhead(file, pageNo, 0);
+		}
+		return;
 	}
-	page = &bufPool[frame];
+	if (pageNo == state.expected)
+		state.run++;
+	else
+	{
+		state.run = 0;
+		state.untilRequest = 0;
+	}
+	state.expected = nextPageNo;
+	if (!state.hinted && state.run < options.readAheadTrigger)
+		return;
+
+	if (miss)
+		readAheadMisses++;
+	// ask for the next window when half of the previous one has been consumed
+	if (state.untilRequest > 0)
+		state.untilRequest--;
+	if (state.untilRequest > 0 || nextPageNo == Page::INVALID_NUMBER)
+		return;
+	queueReadAhead(file, nextPageNo, options.readAheadPages);
+	state.untilRequest = options.readAheadPages / 2 > 0 ? options.readAheadPages / 2 : 1;
+}
+
+void BufMgr::queueReadAhead(File *file, const PageId first, const std::uint32_t count)
+{
+	// the caller's File object may go away before the request is served
+	File *&owned = readAheadFiles[file->id()];
+	if (owned == NULL)
+		owned = new File(*file);
+	ReadAheadRequest request = {owned, first, count};
+	readAheadQueue.push_back(request);
+	readAheadWakeup.notify_one();
+}
+
+void BufMgr::cancelReadAhead(const File *file)
+{
+	std::unique_lock<std::mutex> lock(readAheadLatch);
+	for (std::deque<ReadAheadRequest>::iterator it = readAheadQueue.begin(); it != readAheadQueue.end();)
+	{
+		if (it->file->id() == file->id())
+			it = readAheadQueue.erase(it);
+		else
+			++it;
+	}
+	while (readAheadFile == file->id())
+		readAheadDone.wait(lock);
+	// a dropped request for the used list is asked for again
+	std::unordered_map<FileId, ReadAheadState>::iterator state = readAheadStates.find(file->id());
+	if (state != readAheadStates.end())
+		state->second.listRequested = false;
+}
+
+void BufMgr::hintSequential(File *file, const bool sequential)
+{
+	if (!options.readAheadPages)
+		return;
+	std::lock_guard<std::mutex> lock(readAheadLatch);
+	ReadAheadState &state = readAheadStates[file->id()];
+	state.hinted = sequential;
+	state.untilRequest = 0;
+}
+
+bool BufMgr::allocBuf(BufShard &shard, std::unique_lock<std::mutex> &guard, const File *file,
+					  const PageId pageNo, FrameId &frame)
+{
+	if (!shard.freeFrames.empty())
+	{
+		frame = shard.freeFrames.back();
+		shard.freeFrames.pop_back();
+		return false;
+	}
+	if (shard.numPinned == shard.numFrames)
+		throw BufferExceededException();
+	if (options.cleanFirstWindow && pickCleanVictim(shard, frame))
+	{
+		evictFrame(shard, frame);
+		return false;
+	}
+	// frames being written by the background writer become evictable once it is done
+	bool waited = false;
+	while (!shard.policy->pickVictim(file->id(), pageNo, frame))
+	{
+		if (shard.numWriting == 0)
+			throw BufferExceededException();
+		shard.bufStats.pinWaits++;
+		shard.ioDone.wait(guard);
+		waited = true;
+		if (!shard.freeFrames.empty())
+		{
+			frame = shard.freeFrames.back();
+			shard.freeFrames.pop_back();
+			return true;
+		}
+	}
+
+	evictFrame(shard, frame);
+	return waited;
+}
+
+bool BufMgr::pickCleanVictim(BufShard &shard, FrameId &frame)
+{
+	bool skipped = false;
+	if (!shard.policy->pickCleanVictim(options.cleanFirstWindow, frame, skipped))
+		return false;
+	if (skipped)
+		shard.bufStats.cleanVictims++;
+	return true;
+}
+
+void BufMgr::evictFrame(BufShard &shard, const FrameId frame)
+{
+	BufDesc *nowDesc = &bufDescTable[frame];
+	if (nowDesc->testFlags(BufDesc::DIRTY))
+	{
+		const IOClock::time_point start = IOClock::now();
+		nowDesc->file->writePageFrom(bufPool[frame]);
+		countWrites(shard, nowDesc->fileId, 1, elapsedNs(start));
+		nowDesc->clearFlags(BufDesc::DIRTY);
+		shard.bufStats.dirtyWritebacks++;
+	}
+	unmapFrame(shard, frame);
+	shard.bufStats.evictions++;
+	// the frame no longer holds the page even if reading the new one fails
+	nowDesc->Clear();
+}
+
+void BufMgr::pinFrame(BufShard &shard, const FrameId frame)
+{
+	if (bufDescTable[frame].pin() == 1)
+		shard.numPinned++;
+}
+
+bool BufMgr::unpinFrame(BufShard &shard, const FrameId frame, const bool dirty)
+{
+	std::uint32_t pins;
+	if (!bufDescTable[frame].unpin(dirty, pins))
+		return false;
+	if (pins == 0)
+		shard.numPinned--;
+	return true;
+}
+
+void BufMgr::finishRead(BufShard &shard, const FrameId frame, const bool ok)
+{
+	bufDescTable[frame].clearFlags(BufDesc::READ_IN_PROGRESS);
+	if (!ok)
+	{
+		unmapFrame(shard, frame);
+		freeFrame(shard, frame);
+	}
+	shard.ioDone.notify_all();
+}
+
+void BufMgr::loadFrame(BufShard &shard, const FrameId frame, File *file, const PageId pageNo)
+{
+	shard.hashTable->insert(file, pageNo, frame);
+	shard.fileFrames[file->id()][pageNo] = frame;
+	bufDescTable[frame].Set(file, pageNo);
+	shard.numPinned++;
+	shard.policy->recordLoad(frame);
 }
 
-void BufMgr::unPinPage(File *file, const PageId pageNo, const bool dirty)
+void BufMgr::freeFrame(BufShard &shard, const FrameId frame)
 {
+	// a concurrent unpin either sees the pin count before the reset or none at all
+	if ((bufDescTable[frame].state.exchange(0) & BufDesc::PIN_MASK) != 0)
+		shard.numPinned--;
+	bufDescTable[frame].Clear();
+	shard.policy->recordRemove(frame);
+	shard.freeFrames.push_back(frame);
+}
+
+void BufMgr::unmapFrame(BufShard &shard, const FrameId frame)
+{
+	BufDesc *nowDesc = &bufDescTable[frame];
+	shard.hashTable->tryRemove(nowDesc->file, nowDesc->pageNo);
+	std::unordered_map<FileId, std::map<PageId, FrameId>>::iterator it = shard.fileFrames.find(nowDesc->fileId);
+	if (it != shard.fileFrames.end())
+	{
+		it->second.erase(nowDesc->pageNo);
+		if (it->second.empty())
+			shard.fileFrames.erase(it);
+	}
+}
+
+bool BufMgr::reuseRingFrame(BufShard &shard, BufAccessStrategy &strategy, FrameId &frame)
+{
+	const std::uint32_t s = &shard - shards;
+	if (strategy.rings.empty())
+		return false;
+	std::vector<BufAccessStrategy::Slot> &ring = strategy.rings[s];
+	// the ring grows with the first pages of the scan
+	if (ring.empty() || (ring.size() * numShards < strategy.ringSize && ring.size() < shard.numFrames))
+		return false;
+	const BufAccessStrategy::Slot &slot = ring[strategy.cursors[s]];
+	BufDesc *nowDesc = &bufDescTable[slot.frame];
+	// somebody else may have taken the frame over in the meantime
+	if (!nowDesc->testFlags(BufDesc::VALID) || nowDesc->fileId != slot.fileId || nowDesc->pageNo != slot.pageNo ||
+		nowDesc->pinCount() || nowDesc->testFlags(BufDesc::WRITE_IN_PROGRESS))
+		return false;
+
+	frame = slot.frame;
+	evictFrame(shard, frame);
+	// the policy did not choose the frame, so it still tracks it
+	shard.policy->recordRemove(frame);
+	return true;
+}
+
+void BufMgr::rememberRingFrame(BufShard &shard, BufAccessStrategy &strategy, const FrameId frame)
+{
+	const std::uint32_t s = &shard - shards;
+	if (strategy.rings.empty())
+	{
+		strategy.rings.resize(numShards);
+		strategy.cursors.assign(numShards, 0);
+	}
+	std::vector<BufAccessStrategy::Slot> &ring = strategy.rings[s];
+	BufAccessStrategy::Slot slot = {frame, bufDescTable[frame].fileId, bufDescTable[frame].pageNo};
+	// every shard gets its share of the ring, at least one frame and at most all of its own
+	if (ring.empty() || (ring.size() * numShards < strategy.ringSize && ring.size() < shard.numFrames))
+	{
+		ring.push_back(slot);
+		return;
+	}
+	ring[strategy.cursors[s]] = slot;
+	strategy.cursors[s] = (strategy.cursors[s] + 1) % ring.size();
+}
+
+void BufMgr::readPage(File *file, const PageId pageNo, Page *&page, BufAccessStrategy *strategy,
+					  BufReservation *reservation)
+{
+	// the pin is charged up front so an operator over its quota never touches the pool
+	if (reservation != NULL)
+		reservation->charge();
+	BufShard &shard = shardFor(file, pageNo);
+	std::unique_lock<std::mutex> guard(shard.latch);
 	FrameId frame;
-	try
+	bool miss = false;
+	shard.bufStats.accesses++;
+	while (true)
 	{
-		hashTable->lookup(file, pageNo, frame);
+		// another thread reading the page in holds the frame, wait for it and look again
+		while (shard.hashTable->tryLookup(file, pageNo, frame) &&
+			   bufDescTable[frame].testFlags(BufDesc::READ_IN_PROGRESS))
+		{
+			shard.bufStats.pinWaits++;
+			shard.ioDone.wait(guard);
+		}
+		if (shard.hashTable->tryLookup(file, pageNo, frame))
+		{
+			pinFrame(shard, frame);
+			shard.policy->recordHit(frame);
+			shard.bufStats.hits++;
+			if (bufDescTable[frame].prefetched)
+			{
+				bufDescTable[frame].prefetched = false;
+				shard.bufStats.readAheadHits++;
+			}
+			break;
+		}
+
+		bool waited = false;
+		try
+		{
+			if (strategy == NULL || !reuseRingFrame(shard, *strategy, frame))
+				waited = allocBuf(shard, guard, file, pageNo, frame);
+		}
+		catch (...)
+		{
+			if (reservation != NULL)
+				reservation->credit();
+			throw;
+		}
+		// somebody else may have loaded the page while the latch was released
+		FrameId loaded;
+		if (waited && shard.hashTable->tryLookup(file, pageNo, loaded))
+		{
+			freeFrame(shard, frame);
+			continue;
+		}
+		shard.bufStats.misses++;
+		// the page is mapped before it is read so nobody else reads it in meanwhile;
+		// the shard latch is not held during the read
+		loadFrame(shard, frame, file, pageNo);
+		bufDescTable[frame].setFlags(BufDesc::READ_IN_PROGRESS);
+		guard.unlock();
+		std::uint64_t ns;
+		try
+		{
+			const IOClock::time_point start = IOClock::now();
+			file->readPageInto(pageNo, bufPool[frame]);
+			ns = elapsedNs(start);
+		}
+		catch (...)
+		{
+			guard.lock();
+			finishRead(shard, frame, false);
+			if (reservation != NULL)
+				reservation->credit();
+			throw;
+		}
+		guard.lock();
+		finishRead(shard, frame, true);
+		countReads(shard, file->id(), 1, ns);
+		if (strategy != NULL)
+			rememberRingFrame(shard, *strategy, frame);
+		miss = true;
+		break;
 	}
-	catch (HashNotFoundException &)
+	page = &bufPool[frame];
+	if (!options.readAheadPages)
+		return;
+	guard.unlock();
+	noteRead(file, pageNo, miss);
+}
+
+PageHandle BufMgr::readPage(File *file, const PageId pageNo, BufAccessStrategy *strategy,
+							BufReservation *reservation)
+{
+	Page *page;
+	readPage(file, pageNo, page, strategy, reservation);
+	return PageHandle(this, page - bufPool, page, reservation);
+}
+
+bool BufMgr::probePage(File *file, const PageId pageNo, Page *&page)
+{
+	BufShard &shard = shardFor(file, pageNo);
+	std::lock_guard<std::mutex> guard(shard.latch);
+	FrameId frame;
+	if (!shard.hashTable->tryLookup(file, pageNo, frame) || bufDescTable[frame].testFlags(BufDesc::READ_IN_PROGRESS))
+		return false;
+	pinFrame(shard, frame);
+	shard.policy->recordHit(frame);
+	page = &bufPool[frame];
+	return true;
+}
+
+void BufMgr::unPinPage(File *file, const PageId pageNo, const bool dirty, BufReservation *reservation)
+{
+	BufShard &shard = shardFor(file, pageNo);
+	std::lock_guard<std::mutex> guard(shard.latch);
+	FrameId frame;
+	if (!shard.hashTable->tryLookup(file, pageNo, frame))
 	{
 		printf("the page is not in bufpool\n");
 		return;
 	}
-	BufDesc *nowDesc = &bufDescTable[frame];
-	if (nowDesc->pinCnt)
+	if (unpinFrame(shard, frame, dirty) && reservation != NULL)
+		reservation->credit();
+}
+
+bool BufMgr::tryUnPinPage(File *file, const PageId pageNo, const bool dirty)
+{
+	BufShard &shard = shardFor(file, pageNo);
+	std::lock_guard<std::mutex> guard(shard.latch);
+	FrameId frame;
+	if (!shard.hashTable->tryLookup(file, pageNo, frame))
+		return false;
+	return unpinFrame(shard, frame, dirty);
+}
+
+std::uint32_t BufMgr::reserveVictims(const std::uint32_t count)
+{
+	std::uint32_t numFree = 0;
+	for (std::uint32_t s = 0; s < numShards; s++)
 	{
-		nowDesc->pinCnt--;
-		nowDesc->dirty |= dirty;
+		BufShard &shard = shards[s];
+		const std::uint32_t want = count / numShards + (s < count % numShards ? 1 : 0);
+		std::lock_guard<std::mutex> guard(shard.latch);
+		if (shard.freeFrames.size() < want)
+		{
+			std::uint32_t needed = want - shard.freeFrames.size();
+			// look twice as far as needed so clean victims can be preferred,
+			// a dirty one is only written back if the clean ones run out
+			FrameId frame;
+			bool skipped;
+			while (needed > 0 && shard.policy->pickCleanVictim(2 * needed, frame, skipped))
+			{
+				evictFrame(shard, frame);
+				freeFrame(shard, frame);
+				needed--;
+			}
+			// the Clock policy lists the free frames as well
+			std::vector<FrameId> candidates;
+			shard.policy->peekVictims(2 * needed + shard.freeFrames.size(), candidates);
+			for (std::size_t i = 0; i < candidates.size() && needed > 0; i++)
+			{
+				if (!bufDescTable[candidates[i]].testFlags(BufDesc::VALID))
+					continue;
+				shard.policy->recordEvict(candidates[i]);
+				evictFrame(shard, candidates[i]);
+				freeFrame(shard, candidates[i]);
+				needed--;
+			}
+		}
+		numFree += shard.freeFrames.size();
 	}
+	return numFree;
 }
 
 void BufMgr::flushFile(const File *file)
 {
-	for (FrameId i = 0; i < numBufs; i++)
+	if (options.readAheadPages)
+		cancelReadAhead(file);
+	cancelWarmUp(file);
+
+	// all shards stay latched so the pages of the file can be written in one
+	// ascending pass; other calls never hold more than one shard latch
+	std::vector<std::unique_lock<std::mutex>> guards;
+	std::vector<std::pair<PageId, FrameId>> frames;
+	for (std::uint32_t s = 0; s < numShards; s++)
 	{
-		BufDesc *nowDesc = &bufDescTable[i];
-		if (nowDesc->file == file)
+		BufShard &shard = shards[s];
+		guards.push_back(std::unique_lock<std::mutex>(shard.latch));
+		// pages being written by the background writer must land first
+		while (shard.numWriting)
 		{
-			if (!nowDesc->valid)
+			shard.bufStats.pinWaits++;
+			shard.ioDone.wait(guards.back());
+		}
+		std::unordered_map<FileId, std::map<PageId, FrameId>>::iterator it = shard.fileFrames.find(file->id());
+		if (it == shard.fileFrames.end())
+			continue;
+		for (std::map<PageId, FrameId>::iterator page = it->second.begin(); page != it->second.end(); ++page)
+		{
+			BufDesc *nowDesc = &bufDescTable[page->second];
+			if (!nowDesc->testFlags(BufDesc::VALID))
 			{
-				throw BadBufferException(i, nowDesc->dirty, nowDesc->valid, nowDesc->refbit);
+				throw BadBufferException(page->second, nowDesc->testFlags(BufDesc::DIRTY), false,
+										 nowDesc->testFlags(BufDesc::REFBIT));
 			}
-			if (nowDesc->pinCnt)
+			if (nowDesc->pinCount())
 			{
-				throw PagePinnedException(file->filename(), nowDesc->pageNo, i);
+				throw PagePinnedException(file->filename(), nowDesc->pageNo, page->second);
 			}
-			if (nowDesc->dirty)
+			frames.push_back(*page);
+		}
+	}
+	std::sort(frames.begin(), frames.end());
+
+	{
+		std::vector<const Page *> run;
+		for (std::size_t i = 0; i < frames.size(); i++)
+		{
+			const FrameId frame = frames[i].second;
+			BufDesc *nowDesc = &bufDescTable[frame];
+			if (!nowDesc->testFlags(BufDesc::DIRTY))
+				continue;
+			if (!options.coalesceWrites)
 			{
-				nowDesc->file->writePage(bufPool[i]);
-				nowDesc->dirty = false;
+				const IOClock::time_point start = IOClock::now();
+				nowDesc->file->writePageFrom(bufPool[frame]);
+				countWrites(shardOf(frame), nowDesc->fileId, 1, elapsedNs(start));
 			}
-			hashTable->remove(file, nowDesc->pageNo);
-			nowDesc->Clear();
+			else
+			{
+				if (!run.empty() && run.back()->page_number() + 1 != frames[i].first)
+					writeRun(nowDesc->file, run);
+				run.push_back(&bufPool[frame]);
+			}
+			nowDesc->clearFlags(BufDesc::DIRTY);
 		}
+		if (!run.empty())
+			writeRun(bufDescTable[frames.back().second].file, run);
 	}
+
+	for (std::size_t i = 0; i < frames.size(); i++)
+	{
+		BufShard &shard = shardOf(frames[i].second);
+		unmapFrame(shard, frames[i].second);
+		freeFrame(shard, frames[i].second);
+	}
+
+	// no frame refers to a file opened for a reload or for read-ahead any more; a
+	// running reload may still use it.  file may be one of them, it is not used below.
+	const FileId fileId = file->id();
+	{
+		std::lock_guard<std::mutex> lock(warmLatch);
+		std::map<FileId, File *>::iterator it = warmFiles.find(fileId);
+		if (warmLoads == 0 && it != warmFiles.end())
+		{
+			delete it->second;
+			warmFiles.erase(it);
+		}
+	}
+	dropReadAheadFile(fileId);
+}
+
+void BufMgr::dropReadAheadFile(const FileId fileId)
+{
+	std::lock_guard<std::mutex> lock(readAheadLatch);
+	std::map<FileId, File *>::iterator it = readAheadFiles.find(fileId);
+	if (it == readAheadFiles.end() || readAheadFile == fileId)
+		return;
+	for (std::deque<ReadAheadRequest>::iterator request = readAheadQueue.begin(); request != readAheadQueue.end(); ++request)
+	{
+		if (request->file->id() == fileId)
+			return;
+	}
+	delete it->second;
+	readAheadFiles.erase(it);
 }
 
-void BufMgr::allocPage(File *file, PageId &pageNo, Page *&page)
+void BufMgr::sync(const File *file)
 {
-	Page newpage = file->allocatePage();
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		BufShard &shard = shards[s];
+		std::unique_lock<std::mutex> guard(shard.latch);
+		// a page being written by the background writer may be dirtied again
+		while (shard.numWriting)
+		{
+			shard.bufStats.pinWaits++;
+			shard.ioDone.wait(guard);
+		}
+		std::unordered_map<FileId, std::map<PageId, FrameId>>::iterator it = shard.fileFrames.find(file->id());
+		if (it == shard.fileFrames.end())
+			continue;
+		for (std::map<PageId, FrameId>::iterator page = it->second.begin(); page != it->second.end(); ++page)
+		{
+			BufDesc *nowDesc = &bufDescTable[page->second];
+			if (!nowDesc->testFlags(BufDesc::DIRTY) || nowDesc->pinCount())
+				continue;
+			const IOClock::time_point start = IOClock::now();
+			nowDesc->file->writePageFrom(bufPool[page->second]);
+			countWrites(shard, nowDesc->fileId, 1, elapsedNs(start));
+			nowDesc->clearFlags(BufDesc::DIRTY);
+		}
+	}
+	file->sync();
+}
+
+void BufMgr::writeRun(File *file, std::vector<const Page *> &run)
+{
+	const IOClock::time_point start = IOClock::now();
+	file->writePages(run);
+	// the whole run is accounted to the shard of its first page
+	countWrites(shardOf(run.front() - bufPool), file->id(), run.size(), elapsedNs(start));
+	run.clear();
+}
+
+void BufMgr::allocPage(File *file, PageId &pageNo, Page *&page, BufReservation *reservation)
+{
+	if (reservation != NULL)
+		reservation->charge();
+	const IOClock::time_point start = IOClock::now();
+	Page newpage;
+	try
+	{
+		newpage = file->allocatePage();
+	}
+	catch (...)
+	{
+		if (reservation != NULL)
+			reservation->credit();
+		throw;
+	}
+	const std::uint64_t ns = elapsedNs(start);
+	pageNo = newpage.page_number();
+	BufShard &shard = shardFor(file, pageNo);
+	std::unique_lock<std::mutex> guard(shard.latch);
 	FrameId frame;
-	allocBuf(frame);
+	// nobody else can have mapped a page that was only just allocated, even if
+	// allocBuf() released the latch
+	try
+	{
+		allocBuf(shard, guard, file, pageNo, frame);
+	}
+	catch (...)
+	{
+		if (reservation != NULL)
+			reservation->credit();
+		throw;
+	}
 	bufPool[frame] = newpage;
-	pageNo = newpage.page_number();
-	hashTable->insert(file, pageNo, frame);
-	bufDescTable[frame].Set(file, pageNo);
+	loadFrame(shard, frame, file, pageNo);
+	// the new page is written to the file, nothing is read
+	countWrites(shard, file->id(), 1, ns);
 	page = bufPool + frame;
 }
 
+PageHandle BufMgr::allocPage(File *file, PageId &pageNo, BufReservation *reservation)
+{
+	Page *page;
+	allocPage(file, pageNo, page, reservation);
+	return PageHandle(this, page - bufPool, page, reservation);
+}
+
+void BufMgr::unpinByFrame(const FrameId frame, const bool dirty)
+{
+	// no latch: the pin keeps the frame from changing its page, disposePage()
+	// refuses to drop a pinned page
+	unpinFrame(shardOf(frame), frame, dirty);
+}
+
 void BufMgr::disposePage(File *file, const PageId PageNo)
 {
-	FrameId frame;
+	{
+		BufShard &shard = shardFor(file, PageNo);
+		std::unique_lock<std::mutex> guard(shard.latch);
+		FrameId frame;
+		// a frame being written or read can not be emptied; a written frame still holds
+		// the page afterwards, a failed read drops it
+		while (shard.hashTable->tryLookup(file, PageNo, frame) &&
+			   bufDescTable[frame].testFlags(BufDesc::WRITE_IN_PROGRESS | BufDesc::READ_IN_PROGRESS))
+		{
+			shard.bufStats.pinWaits++;
+			shard.ioDone.wait(guard);
+		}
+		if (shard.hashTable->tryLookup(file, PageNo, frame))
+		{
+			// the frame could be reused while somebody still holds the pin
+			if (bufDescTable[frame].pinCount())
+				throw PagePinnedException(file->filename(), PageNo, frame);
+			unmapFrame(shard, frame);
+			freeFrame(shard, frame);
+		}
+	}
+	file->deletePage(PageNo);
+}
+
+PageHandle::PageHandle(PageHandle &&other)
+	: bufMgr(other.bufMgr), frame(other.frame), page(other.page), dirty(other.dirty),
+	  reservation(other.reservation)
+{
+	other.bufMgr = NULL;
+	other.page = NULL;
+	other.reservation = NULL;
+}
+
+PageHandle &PageHandle::operator=(PageHandle &&other)
+{
+	if (this != &other)
+	{
+		release();
+		bufMgr = other.bufMgr;
+		frame = other.frame;
+		page = other.page;
+		dirty = other.dirty;
+		reservation = other.reservation;
+		other.bufMgr = NULL;
+		other.page = NULL;
+		other.reservation = NULL;
+	}
+	return *this;
+}
+
+void PageHandle::release()
+{
+	if (bufMgr == NULL)
+		return;
+	bufMgr->unpinByFrame(frame, dirty);
+	if (reservation != NULL)
+		reservation->credit();
+	bufMgr = NULL;
+	page = NULL;
+	dirty = false;
+	reservation = NULL;
+}
+
+BufReservation::BufReservation(BufMgr *bufMgr, std::uint32_t quota)
+	: bufMgr(bufMgr), quota(quota), used(0)
+{
+	std::lock_guard<std::mutex> guard(bufMgr->reservationLatch);
+	if (bufMgr->reservedFrames + quota > bufMgr->numBufs)
+		throw BufferExceededException();
+	bufMgr->reservedFrames += quota;
+}
+
+BufReservation::~BufReservation()
+{
+	std::lock_guard<std::mutex> guard(bufMgr->reservationLatch);
+	bufMgr->reservedFrames -= quota;
+}
+
+void BufReservation::charge()
+{
+	std::uint32_t now = used.load();
+	do
+	{
+		if (now >= quota)
+			throw BufferBudgetExceededException(quota);
+	} while (!used.compare_exchange_weak(now, now + 1));
+}
+
+void BufReservation::credit()
+{
+	used--;
+}
+
+void BufMgr::resize(const std::uint32_t bufs)
+{
+	// reservations must keep fitting, BufReservation reads numBufs under this latch
+	std::lock_guard<std::mutex> reservation(reservationLatch);
+	if (bufs < numShards || bufs > numShards * framesPerShard || bufs < reservedFrames)
+		throw BufferExceededException();
+
+	// all shards stay latched so the pool changes size at once, like flushFile()
+	std::vector<std::unique_lock<std::mutex>> guards;
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		BufShard &shard = shards[s];
+		guards.push_back(std::unique_lock<std::mutex>(shard.latch));
+		// frames being written by the background writer can not be dropped
+		while (shard.numWriting)
+		{
+			shard.bufStats.pinWaits++;
+			shard.ioDone.wait(guards.back());
+		}
+	}
+
+	// check every frame to be dropped before touching any, so a failed shrink changes nothing
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		BufShard &shard = shards[s];
+		for (FrameId frame = shard.firstFrame + shardSize(s, bufs); frame < shard.firstFrame + shard.numFrames; frame++)
+		{
+			BufDesc *nowDesc = &bufDescTable[frame];
+			if (nowDesc->testFlags(BufDesc::VALID) && nowDesc->pinCount())
+				throw PagePinnedException(nowDesc->file->filename(), nowDesc->pageNo, frame);
+		}
+	}
+
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		const std::uint32_t numFrames = shardSize(s, bufs);
+		if (numFrames > shards[s].numFrames)
+			growShard(shards[s], numFrames);
+		else if (numFrames < shards[s].numFrames)
+			shrinkShard(shards[s], numFrames);
+	}
+	numBufs = bufs;
+}
+
+std::uint32_t BufMgr::size()
+{
+	std::lock_guard<std::mutex> reservation(reservationLatch);
+	return numBufs;
+}
+
+void BufMgr::growShard(BufShard &shard, const std::uint32_t numFrames)
+{
+	const FrameId end = shard.firstFrame + numFrames;
+	for (FrameId frame = shard.firstFrame + shard.numFrames; frame < end; frame++)
+		new (&bufPool[frame]) Page();
+	// the page table is rehashed incrementally, not here
+	shard.hashTable->resize(numFrames);
+	shard.policy->resize(numFrames);
+	// hand out the new frames in ascending order
+	for (FrameId frame = end; frame > shard.firstFrame + shard.numFrames; frame--)
+		shard.freeFrames.push_back(frame - 1);
+	shard.numFrames = numFrames;
+}
+
+void BufMgr::shrinkShard(BufShard &shard, const std::uint32_t numFrames)
+{
+	const FrameId end = shard.firstFrame + numFrames;
+	for (FrameId frame = end; frame < shard.firstFrame + shard.numFrames; frame++)
+	{
+		if (!bufDescTable[frame].testFlags(BufDesc::VALID))
+			continue;
+		evictFrame(shard, frame);
+		// the policy did not choose the frame, so it still tracks it
+		shard.policy->recordRemove(frame);
+	}
+	std::vector<FrameId>::iterator dropped = std::remove_if(shard.freeFrames.begin(), shard.freeFrames.end(),
+															 [end](const FrameId frame) { return frame >= end; });
+	shard.freeFrames.erase(dropped, shard.freeFrames.end());
+	shard.policy->resize(numFrames);
+	shard.hashTable->resize(numFrames);
+#ifdef MADV_DONTNEED
+	// give the memory of the dropped frames back, frames are page aligned
+	madvise(&bufPool[end], (std::size_t)(shard.numFrames - numFrames) * sizeof(Page), MADV_DONTNEED);
+#endif
+	shard.numFrames = numFrames;
+}
+
+static const char *PAGE_SET_HEADER = "badgerdb page set 1";
+
+bool BufMgr::savePageSet(const std::string &path)
+{
+	typedef std::pair<std::string, std::pair<PageId, bool>> Entry;
+	std::vector<Entry> entries;
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		std::lock_guard<std::mutex> guard(shards[s].latch);
+		for (FrameId i = shards[s].firstFrame; i < shards[s].firstFrame + shards[s].numFrames; i++)
+		{
+			BufDesc *nowDesc = &bufDescTable[i];
+			if (!nowDesc->testFlags(BufDesc::VALID) || nowDesc->testFlags(BufDesc::READ_IN_PROGRESS))
+				continue;
+			entries.push_back(Entry(nowDesc->file->filename(),
+									std::make_pair(nowDesc->pageNo, nowDesc->testFlags(BufDesc::REFBIT))));
+		}
+	}
+	// file and page order lets loadPageSet() read runs of consecutive pages
+	std::sort(entries.begin(), entries.end());
+
+	// written next to the old set and renamed over it, a crash leaves one of both
+	const std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::trunc);
+		out << PAGE_SET_HEADER << "\n";
+		for (std::size_t i = 0; i < entries.size(); i++)
+		{
+			if (i == 0 || entries[i].first != entries[i - 1].first)
+				out << "file " << entries[i].first << "\n";
+			out << entries[i].second.first << " " << entries[i].second.second << "\n";
+		}
+		out.flush();
+		if (!out)
+			return false;
+	}
+	return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+std::uint32_t BufMgr::loadPageSet(const std::string &path)
+{
+	std::ifstream in(path.c_str());
+	std::string line;
+	if (!std::getline(in, line) || line != PAGE_SET_HEADER)
+		return 0;
+	{
+		std::lock_guard<std::mutex> lock(warmLatch);
+		warmLoads++;
+	}
+
+	std::uint32_t loaded = 0;
+	File *file = NULL;
+	PageId first = Page::INVALID_NUMBER;
+	std::vector<bool> refbits;
+	bool more = true;
+	while (more)
+	{
+		const bool eof = !std::getline(in, line);
+		const bool newFile = !eof && line.compare(0, 5, "file ") == 0;
+		PageId pageNo = Page::INVALID_NUMBER;
+		bool refbit = false;
+		if (!eof && !newFile)
+		{
+			std::istringstream entry(line);
+			if (!(entry >> pageNo >> refbit))
+				continue;
+		}
+		// a run ends at a gap, at its maximum length, at the next file and at the end
+		if (!refbits.empty() && (eof || newFile || pageNo != first + refbits.size() ||
+								 refbits.size() == WARM_RUN_PAGES))
+		{
+			more = warmRun(file, first, refbits, loaded);
+			refbits.clear();
+		}
+		if (eof || newFile)
+		{
+			std::lock_guard<std::mutex> lock(warmLatch);
+			warmFile = File::INVALID_ID;
+			warmDone.notify_all();
+		}
+		if (eof || !more)
+			break;
+		if (newFile)
+		{
+			file = NULL;
+			const std::string name = line.substr(5);
+			if (!File::exists(name))
+				continue;
+			File opened = File::open(name);
+			std::lock_guard<std::mutex> lock(warmLatch);
+			if (warmStop)
+				break;
+			if (warmSkip.count(name))
+				continue;
+			std::map<FileId, File *>::iterator it = warmFiles.find(opened.id());
+			if (it == warmFiles.end())
+				it = warmFiles.insert(std::make_pair(opened.id(), new File(opened))).first;
+			file = it->second;
+			warmFile = file->id();
+			continue;
+		}
+		if (file == NULL)
+			continue;
+		if (refbits.empty())
+			first = pageNo;
+		refbits.push_back(refbit);
+	}
+
+	std::lock_guard<std::mutex> lock(warmLatch);
+	warmFile = File::INVALID_ID;
+	if (--warmLoads == 0)
+		warmSkip.clear();
+	warmDone.notify_all();
+	return loaded;
+}
+
+bool BufMgr::warmRun(File *file, const PageId first, const std::vector<bool> &refbits, std::uint32_t &loaded)
+{
+	{
+		std::lock_guard<std::mutex> lock(warmLatch);
+		if (warmStop)
+			return false;
+		if (warmSkip.count(file->filename()))
+			return true;
+	}
+
+	// map every page to a free frame first, then read the whole run with one call;
+	// pages that are already resident are read into a scratch page
+	Page scratch;
+	std::vector<Page *> pages;
+	std::vector<FrameId> frames;
+	std::vector<bool> mapped;
+	bool full = false;
+	for (std::uint32_t i = 0; i < refbits.size(); i++)
+	{
+		const PageId pageNo = first + i;
+		BufShard &shard = shardFor(file, pageNo);
+		std::lock_guard<std::mutex> guard(shard.latch);
+		FrameId frame;
+		if (shard.hashTable->tryLookup(file, pageNo, frame))
+		{
+			pages.push_back(&scratch);
+			frames.push_back(frame);
+			mapped.push_back(false);
+			continue;
+		}
+		// like read-ahead, the reload never evicts
+		if (shard.freeFrames.empty())
+		{
+			full = true;
+			break;
+		}
+		frame = shard.freeFrames.back();
+		shard.freeFrames.pop_back();
+		loadFrame(shard, frame, file, pageNo);
+		bufDescTable[frame].setFlags(BufDesc::READ_IN_PROGRESS);
+		pages.push_back(&bufPool[frame]);
+		frames.push_back(frame);
+		mapped.push_back(true);
+	}
+	while (!pages.empty() && !mapped.back())
+	{
+		pages.pop_back();
+		frames.pop_back();
+		mapped.pop_back();
+	}
+	if (pages.empty())
+		return !full;
+
+	std::uint64_t ns = 0;
+	bool ok = true;
 	try
 	{
-		hashTable->lookup(file, PageNo, frame);
-		hashTable->remove(file, PageNo);
-		bufDescTable[frame].Clear();
+		const IOClock::time_point start = IOClock::now();
+		file->readPages(first, pages);
+		ns = elapsedNs(start);
 	}
-	catch (const std::exception&)
+	catch (...)
 	{
-		printf("the page is not in bufpool\n");
+		ok = false;
 	}
-	file->deletePage(PageNo);
+
+	bool counted = false;
+	for (std::size_t i = 0; i < frames.size(); i++)
+	{
+		if (!mapped[i])
+			continue;
+		BufShard &shard = shardOf(frames[i]);
+		std::lock_guard<std::mutex> guard(shard.latch);
+		// pages deleted since the set was saved come back NULL
+		const bool good = ok && pages[i] != NULL;
+		finishRead(shard, frames[i], good);
+		if (!good)
+			continue;
+		unpinFrame(shard, frames[i], false);
+		if (!refbits[i])
+			bufDescTable[frames[i]].clearFlags(BufDesc::REFBIT);
+		shard.bufStats.warmUpReads++;
+		loaded++;
+		if (!counted)
+		{
+			// the whole read is accounted to the shard of its first page
+			countReads(shard, file->id(), pages.size(), ns);
+			counted = true;
+		}
+	}
+	return !full;
+}
+
+void BufMgr::warmUp(const std::string path)
+{
+	loadPageSet(path);
+	std::lock_guard<std::mutex> lock(warmLatch);
+	warming = false;
+	warmDone.notify_all();
+}
+
+void BufMgr::waitForWarmUp()
+{
+	std::unique_lock<std::mutex> lock(warmLatch);
+	while (warming)
+		warmDone.wait(lock);
+}
+
+void BufMgr::cancelWarmUp(const File *file)
+{
+	std::unique_lock<std::mutex> lock(warmLatch);
+	if (warmLoads == 0)
+		return;
+	warmSkip.insert(file->filename());
+	while (warmFile == file->id())
+		warmDone.wait(lock);
+}
+
+BufStats BufMgr::getBufStats()
+{
+	BufStats total;
+	total.policy = shards[0].bufStats.policy;
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		std::lock_guard<std::mutex> guard(shards[s].latch);
+		total.add(shards[s].bufStats);
+	}
+	std::lock_guard<std::mutex> lock(readAheadLatch);
+	total.readAheadMisses = readAheadMisses;
+	return total;
+}
+
+void BufMgr::clearBufStats()
+{
+	for (std::uint32_t s = 0; s < numShards; s++)
+	{
+		std::lock_guard<std::mutex> guard(shards[s].latch);
+		shards[s].bufStats.clear();
+	}
+	std::lock_guard<std::mutex> lock(readAheadLatch);
+	readAheadMisses = 0;
 }
 
 void BufMgr::printSelf(void)
@@ -195,14 +1483,18 @@ void BufMgr::printSelf(void)
 	BufDesc *tmpbuf;
 	int validFrames = 0;
 
-	for (std::uint32_t i = 0; i < numBufs; i++)
+	for (std::uint32_t s = 0; s < numShards; s++)
 	{
-		tmpbuf = &(bufDescTable[i]);
-		std::cout << "FrameNo:" << i << " ";
-		tmpbuf->Print();
+		std::lock_guard<std::mutex> guard(shards[s].latch);
+		for (FrameId i = shards[s].firstFrame; i < shards[s].firstFrame + shards[s].numFrames; i++)
+		{
+			tmpbuf = &(bufDescTable[i]);
+			std::cout << "FrameNo:" << i << " ";
+			tmpbuf->Print();
 
-		if (tmpbuf->valid == true)
-			validFrames++;
+			if (tmpbuf->testFlags(BufDesc::VALID))
+				validFrames++;
+		}
 	}
 
 	std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
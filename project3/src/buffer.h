@@ -8,8 +8,20 @@
 #pragma once
 
 #include "file.h"
-#include "bufHashTbl.h"
+#include "bufFlatHashTbl.h"
+#include "replacement_policy.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace badgerdb
 {
@@ -21,18 +33,64 @@ class BufMgr;
 
 /**
 * @brief Class for maintaining information about buffer pool frames
+*
+* The pin count and the flags of a frame are packed into one atomic state word,
+* so pins, unpins, dirty marking and reference bit updates are single atomic
+* operations.  Unpinning through the frame needs no latch at all.  Everything
+* else (which page the frame holds, loading and evicting it) is still protected
+* by the latch of the shard owning the frame; reads and writes of the page set
+* READ_IN_PROGRESS or WRITE_IN_PROGRESS, which act as the latch of the frame
+* while the shard latch is released for the I/O.
 */
 class BufDesc
 {
 
     friend class BufMgr;
+    friend class ReplacementPolicy;
 
 private:
+    /**
+   * Bits of the state word holding the pin count
+	 */
+    static const std::uint64_t PIN_MASK = 0xFFFFFFFFULL;
+
+    /**
+   * Set if the frame holds a page
+	 */
+    static const std::uint64_t VALID = 1ULL << 32;
+
+    /**
+   * Set if the page has been modified since it was read or last written
+	 */
+    static const std::uint64_t DIRTY = 1ULL << 33;
+
+    /**
+   * Set if the page has been referenced recently
+	 */
+    static const std::uint64_t REFBIT = 1ULL << 34;
+
+    /**
+   * Set while the background writer is writing the page out.  The frame can
+   * be pinned meanwhile but not evicted or flushed.
+	 */
+    static const std::uint64_t WRITE_IN_PROGRESS = 1ULL << 35;
+
+    /**
+   * Set while the page is being read from disk into the frame.  The frame is
+   * pinned by the reader; other threads wait until the read is done.
+	 */
+    static const std::uint64_t READ_IN_PROGRESS = 1ULL << 36;
+
     /**
    * Pointer to file to which corresponding frame is assigned
 	 */
     File *file;
 
+    /**
+   * Id of the file to which corresponding frame is assigned
+	 */
+    FileId fileId;
+
     /**
    * Page within file to which corresponding frame is assigned
 	 */
@@ -44,36 +102,84 @@ private:
     FrameId frameNo;
 
     /**
-   * Number of times this page has been pinned
+   * Pin count in the low 32 bits and the flags above
 	 */
-    int pinCnt;
+    std::atomic<std::uint64_t> state;
 
     /**
-   * True if page is dirty;  false otherwise
+   * True if the page was read ahead and has not been requested since
 	 */
-    bool dirty;
+    bool prefetched;
+
+    /**
+   * Returns the number of times this page has been pinned
+	 */
+    std::uint32_t pinCount() const
+    {
+        return state.load() & PIN_MASK;
+    }
+
+    /**
+   * Returns true if any of the flags is set
+	 */
+    bool testFlags(const std::uint64_t flags) const
+    {
+        return (state.load() & flags) != 0;
+    }
 
     /**
-   * True if page is valid
+   * Sets the flags
 	 */
-    bool valid;
+    void setFlags(const std::uint64_t flags)
+    {
+        state.fetch_or(flags);
+    }
+
+    /**
+   * Clears the flags
+	 */
+    void clearFlags(const std::uint64_t flags)
+    {
+        state.fetch_and(~flags);
+    }
+
+    /**
+   * Increments the pin count and returns the new count
+	 */
+    std::uint32_t pin()
+    {
+        return (state.fetch_add(1) & PIN_MASK) + 1;
+    }
 
     /**
-   * Has this buffer frame been reference recently
+   * Decrements the pin count and marks the page dirty in one step
+	 *
+	 * @param dirty		True if the page needs to be marked dirty
+	 * @param pins		Pin count left after the unpin
+	 * @return  			False if the frame was not pinned.
 	 */
-    bool refbit;
+    bool unpin(const bool dirty, std::uint32_t &pins)
+    {
+        std::uint64_t old = state.load();
+        do
+        {
+            if ((old & PIN_MASK) == 0)
+                return false;
+        } while (!state.compare_exchange_weak(old, (old - 1) | (dirty ? DIRTY : 0)));
+        pins = (old & PIN_MASK) - 1;
+        return true;
+    }
 
     /**
    * Initialize buffer frame for a new user
 	 */
     void Clear()
     {
-        pinCnt = 0;
+        state.store(0);
+        prefetched = false;
         file = NULL;
+        fileId = File::INVALID_ID;
         pageNo = Page::INVALID_NUMBER;
-        dirty = false;
-        refbit = false;
-        valid = false;
     };
 
     /**
@@ -86,11 +192,11 @@ private:
     void Set(File *filePtr, PageId pageNum)
     {
         file = filePtr;
+        fileId = filePtr->id();
         pageNo = pageNum;
-        pinCnt = 1;
-        dirty = false;
-        valid = true;
-        refbit = true;
+        prefetched = false;
+        // pinned once, clean, valid and recently referenced
+        state.store(VALID | REFBIT | 1);
     }
 
     void Print()
@@ -103,10 +209,10 @@ private:
         else
             std::cout << "file:NULL ";
 
-        std::cout << "valid:" << valid << " ";
-        std::cout << "pinCnt:" << pinCnt << " ";
-        std::cout << "dirty:" << dirty << " ";
-        std::cout << "refbit:" << refbit << "\n";
+        std::cout << "valid:" << testFlags(VALID) << " ";
+        std::cout << "pinCnt:" << pinCount() << " ";
+        std::cout << "dirty:" << testFlags(DIRTY) << " ";
+        std::cout << "refbit:" << testFlags(REFBIT) << "\n";
     }
 
     /**
@@ -118,6 +224,122 @@ private:
     }
 };
 
+/**
+* @brief Histogram of operation latencies in power of two buckets
+*/
+struct LatencyHistogram
+{
+    /**
+   * Number of buckets, bucket i counts latencies in [2^i, 2^(i+1)) nanoseconds
+   * and the last one everything above
+	 */
+    static const int NUM_BUCKETS = 40;
+
+    /**
+   * Number of operations per bucket
+	 */
+    std::uint64_t buckets[NUM_BUCKETS];
+
+    /**
+   * Number of operations recorded
+	 */
+    std::uint64_t count;
+
+    /**
+   * Sum of all recorded latencies in nanoseconds
+	 */
+    std::uint64_t totalNs;
+
+    /**
+   * Adds one operation that took the given number of nanoseconds
+	 */
+    void record(std::uint64_t ns)
+    {
+        int bucket = 0;
+        while (ns >> (bucket + 1) && bucket < NUM_BUCKETS - 1)
+            bucket++;
+        buckets[bucket]++;
+        count++;
+        totalNs += ns;
+    }
+
+    /**
+   * Adds all operations recorded by another histogram
+	 */
+    void add(const LatencyHistogram &other)
+    {
+        for (int i = 0; i < NUM_BUCKETS; i++)
+            buckets[i] += other.buckets[i];
+        count += other.count;
+        totalNs += other.totalNs;
+    }
+
+    /**
+   * Upper bound in nanoseconds of the bucket holding the given fraction (0..1]
+   * of the operations, 0 if there were no operations
+	 */
+    std::uint64_t percentile(double fraction) const
+    {
+        std::uint64_t seen = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++)
+        {
+            seen += buckets[i];
+            if (count && seen >= fraction * count)
+                return (std::uint64_t)2 << i;
+        }
+        return 0;
+    }
+
+    /**
+   * Mean latency in nanoseconds, 0 if there were no operations
+	 */
+    double mean() const
+    {
+        return count ? (double)totalNs / count : 0;
+    }
+
+    /**
+   * Clear all values
+	 */
+    void clear()
+    {
+        for (int i = 0; i < NUM_BUCKETS; i++)
+            buckets[i] = 0;
+        count = totalNs = 0;
+    }
+
+    /**
+   * Constructor of LatencyHistogram class
+	 */
+    LatencyHistogram()
+    {
+        clear();
+    }
+};
+
+/**
+* @brief Disk traffic the buffer manager caused on one file
+*/
+struct FileIOStats
+{
+    /**
+   * Number of pages read from the file
+	 */
+    int reads;
+
+    /**
+   * Number of pages written to the file
+	 */
+    int writes;
+
+    /**
+   * Constructor of FileIOStats class
+	 */
+    FileIOStats() : reads(0), writes(0)
+    {
+    }
+};
+
 /**
 * @brief Class to maintain statistics of buffer usage 
 */
@@ -128,6 +350,16 @@ struct BufStats
 	 */
     int accesses;
 
+    /**
+   * Number of accesses served without reading from disk
+	 */
+    int hits;
+
+    /**
+   * Number of accesses that had to read the page from disk (or allocate it)
+	 */
+    int misses;
+
     /**
    * Number of pages read from disk (including allocs)
 	 */
@@ -138,159 +370,1265 @@ struct BufStats
 	 */
     int diskwrites;
 
+    /**
+   * Number of pages pushed out of their frame to make room for another page
+	 */
+    int evictions;
+
+    /**
+   * Number of evicted pages that were dirty and had to be written on the spot
+	 */
+    int dirtyWritebacks;
+
+    /**
+   * Number of times a call had to wait for a frame busy with background I/O
+	 */
+    int pinWaits;
+
+    /**
+   * Number of the disk writes done by the background writer, so no foreground
+   * miss had to wait for them
+	 */
+    int writerWrites;
+
+    /**
+   * Number of victims taken ahead of the policy's choice because they were clean
+	 */
+    int cleanVictims;
+
+    /**
+   * Number of accesses served by a page that had been read ahead
+	 */
+    int readAheadHits;
+
+    /**
+   * Number of accesses of a sequential scan that still had to read from disk
+	 */
+    int readAheadMisses;
+
+    /**
+   * Number of pages read ahead (included in diskreads)
+	 */
+    int readAheadReads;
+
+    /**
+   * Number of pages reloaded by a warm restart (included in diskreads)
+	 */
+    int warmUpReads;
+
+    /**
+   * Pages read and written per file
+	 */
+    std::map<FileId, FileIOStats> fileIO;
+
+    /**
+   * Latency of the disk reads
+	 */
+    LatencyHistogram readLatency;
+
+    /**
+   * Latency of the disk writes, a coalesced write counts once
+	 */
+    LatencyHistogram writeLatency;
+
+    /**
+   * Name of the replacement policy the statistics were collected with
+	 */
+    const char *policy;
+
+    /**
+   * Fraction of accesses that were hits, 0 if there were no accesses
+	 */
+    double hitRatio() const
+    {
+        return accesses ? (double)hits / accesses : 0;
+    }
+
+    /**
+   * Number of pages read from and written to disk
+	 */
+    int diskIOs() const
+    {
+        return diskreads + diskwrites;
+    }
+
+    /**
+   * Adds the counts of another BufStats object
+	 */
+    void add(const BufStats &other)
+    {
+        accesses += other.accesses;
+        hits += other.hits;
+        misses += other.misses;
+        diskreads += other.diskreads;
+        diskwrites += other.diskwrites;
+        evictions += other.evictions;
+        dirtyWritebacks += other.dirtyWritebacks;
+        pinWaits += other.pinWaits;
+        writerWrites += other.writerWrites;
+        cleanVictims += other.cleanVictims;
+        readAheadHits += other.readAheadHits;
+        readAheadMisses += other.readAheadMisses;
+        readAheadReads += other.readAheadReads;
+        warmUpReads += other.warmUpReads;
+        for (std::map<FileId, FileIOStats>::const_iterator it = other.fileIO.begin(); it != other.fileIO.end(); ++it)
+        {
+            fileIO[it->first].reads += it->second.reads;
+            fileIO[it->first].writes += it->second.writes;
+        }
+        readLatency.add(other.readLatency);
+        writeLatency.add(other.writeLatency);
+    }
+
     /**
    * Clear all values 
 	 */
     void clear()
     {
-        accesses = diskreads = diskwrites = 0;
+        accesses = hits = misses = diskreads = diskwrites = 0;
+        evictions = dirtyWritebacks = pinWaits = writerWrites = cleanVictims = 0;
+        readAheadHits = readAheadMisses = readAheadReads = warmUpReads = 0;
+        fileIO.clear();
+        readLatency.clear();
+        writeLatency.clear();
     }
 
     /**
    * Constructor of BufStats class 
 	 */
-    BufStats()
+    BufStats() : policy("")
     {
         clear();
     }
 };
 
 /**
-* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+* @brief Construction time settings of the buffer manager
 */
-class BufMgr
+struct BufMgrOptions
 {
-private:
     /**
-   * Current position of clockhand in our buffer pool
-   * 时钟算法的时针
+   * Number of independently latched shards the pool is split into.  Each shard
+   * owns a contiguous range of frames together with its own hash partition and
+   * clock hand.  A value of 1 gives the classic single clock over the whole pool.
 	 */
-    FrameId clockHand;
+    std::uint32_t numShards;
 
     /**
-   * Number of frames in the buffer pool
-   * 缓冲池中的帧数
+   * Number of frames BufMgr::resize() may grow the pool to, 0 means the initial
+   * size.  Address space for this many frames is reserved up front so pages never
+   * move; memory is only committed for frames in use.
 	 */
-    std::uint32_t numBufs;
+    std::uint32_t maxBufs;
 
     /**
-   * Hash table mapping (File, page) to frame
-   * 哈希表（file指针，page）到帧的映射
+   * Replacement policy used by every shard
 	 */
-    BufHashTbl *hashTable;
+    ReplacementPolicyType policy;
 
     /**
-   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
-   * BufDesc对象的数组，用于保存与“ bufPool”（缓冲池）中的每个帧分配相对应的信息
+   * Number of accesses remembered per page by LRU_K_POLICY
 	 */
-    BufDesc *bufDescTable;
+    std::uint32_t lruK;
 
     /**
-   * Maintains Buffer pool usage statistics 
+   * Start a background thread writing back dirty unpinned frames that are about
+   * to become victims, so foreground misses find clean frames
 	 */
-    BufStats bufStats;
+    bool backgroundWriter;
 
     /**
-   * Advance clock to next frame in the buffer pool
-   * 将时钟移动到缓冲池中的下一帧
+   * Number of upcoming victims the writer inspects per shard and round
 	 */
-    void advanceClock();
+    std::uint32_t writerLookahead;
 
     /**
-	 * Allocate a free frame.  
-	 *
-	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-	 * @throws BufferExceededException If no such buffer is found which can be allocated
+   * Maximum number of pages the writer writes per round, over all shards
 	 */
-    void allocBuf(FrameId &frame);
+    std::uint32_t writerBatchPages;
 
-public:
     /**
-   * Actual buffer pool from which frames are allocated
+   * Milliseconds the writer sleeps between two rounds
 	 */
-    Page *bufPool;
+    std::uint32_t writerIntervalMs;
 
     /**
-   * Constructor of BufMgr class
+   * Number of upcoming victims searched for a clean page before a dirty one is
+   * evicted, 0 always evicts the policy's first choice.  Trades some hit ratio
+   * for misses that do not wait for a write-back.
 	 */
-    BufMgr(std::uint32_t bufs);
+    std::uint32_t cleanFirstWindow;
 
     /**
-   * Destructor of BufMgr class
+   * Let flushFile() write runs of dirty pages with consecutive numbers with one
+   * write call instead of one call per page
 	 */
-    ~BufMgr();
+    bool coalesceWrites;
 
     /**
-	 * Reads the given page from the file into a frame and returns the pointer to page.
-	 * If the requested page is already present in the buffer pool pointer to that frame is returned
-	 * otherwise a new frame is allocated from the buffer pool for reading the page.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number in the file to be read
-	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+   * Ask the kernel to back the frame arena with transparent huge pages
 	 */
-    void readPage(File *file, const PageId PageNo, Page *&page);
+    bool hugePages;
 
     /**
-	 * Unpin a page from memory since it is no longer required for it to remain in memory.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
-	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
-   * @throws  PageNotPinnedException If the page is not already pinned
+   * Bind the frames of every shard to a NUMA node, assigning shards to the online
+   * nodes round robin; numShards is raised to the number of nodes if it is lower.
+   * Ignored on single node hosts and where mbind() is not available.
 	 */
-    void unPinPage(File *file, const PageId PageNo, const bool dirty);
+    bool numaAware;
 
     /**
-	 * Allocates a new, empty page in the file and returns the Page object.
-	 * The newly allocated page is also assigned a frame in the buffer pool.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
-	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+   * Page set file for warm restarts, empty to disable them.  The pool reloads
+   * the pages listed in it in the background when it is constructed and saves
+   * its resident pages to it when it is destroyed.
 	 */
-    void allocPage(File *file, PageId &PageNo, Page *&page);
+    std::string warmStartFile;
 
     /**
-	 * Writes out all dirty pages of the file to disk.
-	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
-	 * Otherwise Error returned.
-	 *
-	 * @param file   	File object
-   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
-   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+   * Number of pages read ahead along the used page chain of a file once it is
+   * scanned sequentially, 0 disables read-ahead.  Pages are only read into free
+   * frames, read-ahead never evicts.
 	 */
-    void flushFile(const File *file);
+    std::uint32_t readAheadPages;
 
     /**
-	 * Delete page from file and also from buffer pool if present.
-	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
+   * Number of consecutive readPage() calls following the used page chain after
+   * which a scan counts as sequential without a hint
 	 */
-    void disposePage(File *file, const PageId PageNo);
+    std::uint32_t readAheadTrigger;
 
     /**
-   * Print member variable values. 
+   * Constructor of BufMgrOptions class
 	 */
-    void printSelf();
+    BufMgrOptions()
+        : numShards(1), maxBufs(0), policy(CLOCK_POLICY), lruK(2), backgroundWriter(false),
+          writerLookahead(16), writerBatchPages(32), writerIntervalMs(10), cleanFirstWindow(0),
+          coalesceWrites(false), hugePages(false), numaAware(false), readAheadPages(0), readAheadTrigger(2)
+    {
+    }
+};
+
+/**
+* @brief One latched partition of the buffer pool
+*
+* A page is always cached in the shard selected by hashing (file, pageNo), so
+* two threads only contend when they touch pages of the same shard.
+*/
+class BufShard
+{
+
+    friend class BufMgr;
 
+private:
     /**
-   * Get buffer pool usage statistics
+   * Protects every member of this shard as well as the descriptors of its frames,
+   * except for unpins which only touch the atomic state word
 	 */
-    BufStats &getBufStats()
-    {
-        return bufStats;
-    }
+    std::mutex latch;
 
     /**
-   * Clear buffer pool usage statistics
+   * First frame of the buffer pool owned by this shard
 	 */
-    void clearBufStats()
-    {
-        bufStats.clear();
-    }
+    FrameId firstFrame;
+
+    /**
+   * Number of frames owned by this shard, the frames up to the next shard are reserved for growing
+	 */
+    std::uint32_t numFrames;
+
+    /**
+   * Replacement policy choosing victims among the frames of this shard
+	 */
+    ReplacementPolicy *policy;
+
+    /**
+   * Frames of this shard that hold no page, handed out before asking the policy
+	 */
+    std::vector<FrameId> freeFrames;
+
+    /**
+   * Number of frames of this shard whose pin count is not zero
+	 */
+    std::atomic<std::uint32_t> numPinned;
+
+    /**
+   * Number of frames of this shard the background writer is writing out
+	 */
+    std::uint32_t numWriting;
+
+    /**
+   * Signalled with the latch held whenever the writer finishes a frame of this shard
+	 */
+    std::condition_variable ioDone;
+
+    /**
+   * Open addressing hash table mapping (File, page) to frame for the pages cached in this shard
+	 */
+    BufFlatHashTbl *hashTable;
+
+    /**
+   * Frames of this shard holding pages of each file, keyed by page number so
+   * flushFile() neither scans the pool nor writes in frame order
+	 */
+    std::unordered_map<FileId, std::map<PageId, FrameId>> fileFrames;
+
+    /**
+   * NUMA node the frames of this shard are bound to, -1 if not bound
+	 */
+    int numaNode;
+
+    /**
+   * Usage statistics of this shard
+	 */
+    BufStats bufStats;
+
+    /**
+   * Constructor of BufShard class
+	 */
+    BufShard() : firstFrame(0), numFrames(0), policy(NULL), numPinned(0), numWriting(0), hashTable(NULL)
+    {
+    }
+};
+
+/**
+* @brief Sequential access detection state of one file
+*/
+struct ReadAheadState
+{
+    /**
+   * Page following the last page read on the used page chain
+	 */
+    PageId expected;
+
+    /**
+   * Number of consecutive reads that followed the chain
+	 */
+    std::uint32_t run;
+
+    /**
+   * Reads left until the next read-ahead request is queued
+	 */
+    std::uint32_t untilRequest;
+
+    /**
+   * Set through BufMgr::hintSequential(), the file is read ahead from its first read
+	 */
+    bool hinted;
+
+    /**
+   * Set once the read-ahead thread has been asked to read the used list of the file
+	 */
+    bool listRequested;
+
+    /**
+   * Constructor of ReadAheadState class
+	 */
+    ReadAheadState() : expected(Page::INVALID_NUMBER), run(0), untilRequest(0), hinted(false), listRequested(false)
+    {
+    }
+};
+
+/**
+* @brief Pages the read-ahead thread is asked to bring into the pool
+*/
+struct ReadAheadRequest
+{
+    /**
+   * File to read from, the buffer manager's own copy in readAheadFiles
+	 */
+    File *file;
+
+    /**
+   * First page to read, the others follow on the used page chain
+	 */
+    PageId first;
+
+    /**
+   * Number of pages to read, 0 only reads the used list of the file
+	 */
+    std::uint32_t count;
+};
+
+/**
+* @brief Bulk access strategy: a small private ring of frames reused by one scan
+*
+* A scan passing the same strategy to every BufMgr::readPage() call keeps
+* loading its pages into the frames of the ring once the ring is full, instead
+* of evicting pages of the rest of the pool.  A strategy belongs to one thread
+* and one buffer manager.
+*/
+class BufAccessStrategy
+{
+
+    friend class BufMgr;
+
+public:
+    /**
+   * Number of frames of the ring if none is given
+	 */
+    static const std::uint32_t DEFAULT_RING_SIZE = 16;
+
+    /**
+   * Constructor of BufAccessStrategy class
+	 *
+	 * @param ringSize  Number of frames the scan may occupy
+	 */
+    explicit BufAccessStrategy(std::uint32_t ringSize = DEFAULT_RING_SIZE) : ringSize(ringSize)
+    {
+    }
+
+private:
+    /**
+   * Frame of the ring together with the page the scan loaded into it
+	 */
+    struct Slot
+    {
+        FrameId frame;
+        FileId fileId;
+        PageId pageNo;
+    };
+
+    /**
+   * Number of frames the scan may occupy, split evenly over the shards
+	 */
+    std::uint32_t ringSize;
+
+    /**
+   * Ring of every shard, filled up to its share of ringSize before frames are reused
+	 */
+    std::vector<std::vector<Slot>> rings;
+
+    /**
+   * Slot of every ring reused next once the ring is full
+	 */
+    std::vector<std::uint32_t> cursors;
+};
+
+/**
+* @brief Quota of frames one operator may keep pinned at a time
+*
+* Pages read or allocated through BufMgr with a reservation are charged to it
+* while they are pinned.  A pin beyond the quota fails fast with
+* BufferBudgetExceededException, so the operator can spill or give up instead
+* of crowding out other queries.  The quotas of all live reservations of a
+* buffer manager add up to at most its number of frames.
+*/
+class BufReservation
+{
+
+    friend class BufMgr;
+    friend class PageHandle;
+
+public:
+    /**
+   * Sets aside quota frames of the buffer manager for the caller
+	 *
+	 * @param bufMgr  Buffer manager to reserve frames of
+	 * @param quota   Number of frames the caller may keep pinned at a time
+	 * @throws BufferExceededException If the other reservations leave fewer than quota frames
+	 */
+    BufReservation(BufMgr *bufMgr, std::uint32_t quota);
+
+    /**
+   * Gives the frames back to the buffer manager
+	 */
+    ~BufReservation();
+
+    BufReservation(const BufReservation &) = delete;
+
+    BufReservation &operator=(const BufReservation &) = delete;
+
+    /**
+   * Returns the number of frames the caller may keep pinned at a time
+	 */
+    std::uint32_t getQuota() const { return quota; }
+
+    /**
+   * Returns the number of pins currently charged to the reservation
+	 */
+    std::uint32_t getUsed() const { return used; }
+
+private:
+    /**
+   * Charges one pin, throws BufferBudgetExceededException if the quota is used up
+	 */
+    void charge();
+
+    /**
+   * Takes back the charge of one pin
+	 */
+    void credit();
+
+    /**
+   * Buffer manager the frames are reserved in
+	 */
+    BufMgr *bufMgr;
+
+    /**
+   * Number of frames the caller may keep pinned at a time
+	 */
+    const std::uint32_t quota;
+
+    /**
+   * Number of pins currently charged
+	 */
+    std::atomic<std::uint32_t> used;
+};
+
+/**
+* @brief Pin of one page of the buffer pool, released when the handle goes away
+*
+* Returned by the PageHandle variants of BufMgr::readPage() and BufMgr::allocPage().
+* The handle remembers the frame of the page, so unpinning needs no page table
+* lookup.  Handles can be moved but not copied; every handle unpins exactly once.
+*/
+class PageHandle
+{
+
+    friend class BufMgr;
+
+public:
+    /**
+   * Constructs a handle that holds no page
+	 */
+    PageHandle() : bufMgr(NULL), frame(0), page(NULL), dirty(false), reservation(NULL)
+    {
+    }
+
+    PageHandle(PageHandle &&other);
+
+    PageHandle &operator=(PageHandle &&other);
+
+    PageHandle(const PageHandle &) = delete;
+
+    PageHandle &operator=(const PageHandle &) = delete;
+
+    /**
+   * Unpins the page, marking it dirty if markDirty() was called
+	 */
+    ~PageHandle()
+    {
+        release();
+    }
+
+    /**
+   * Unpins the page now.  The handle holds no page afterwards.
+	 */
+    void release();
+
+    /**
+   * Remembers that the page has been modified, so it is unpinned dirty
+	 */
+    void markDirty() { dirty = true; }
+
+    /**
+   * Returns true if the handle holds a page
+	 */
+    explicit operator bool() const { return page != NULL; }
+
+    Page *get() const { return page; }
+
+    Page *operator->() const { return page; }
+
+    Page &operator*() const { return *page; }
+
+    /**
+   * Returns the frame the page is cached in
+	 */
+    FrameId frameNo() const { return frame; }
+
+private:
+    /**
+   * Constructor used by BufMgr for a page it has just pinned
+	 */
+    PageHandle(BufMgr *bufMgr, const FrameId frame, Page *page, BufReservation *reservation)
+        : bufMgr(bufMgr), frame(frame), page(page), dirty(false), reservation(reservation)
+    {
+    }
+
+    /**
+   * Buffer manager the page is pinned in, NULL if the handle holds no page
+	 */
+    BufMgr *bufMgr;
+
+    /**
+   * Frame the page is cached in
+	 */
+    FrameId frame;
+
+    /**
+   * The pinned page
+	 */
+    Page *page;
+
+    /**
+   * True if the page has to be unpinned dirty
+	 */
+    bool dirty;
+
+    /**
+   * Reservation the pin is charged to, NULL if none
+	 */
+    BufReservation *reservation;
+};
+
+/**
+* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* readPage(), unPinPage(), allocPage(), flushFile() and disposePage() may be called
+* concurrently from several threads.  Calls only serialize on the latch of the
+* shard owning the page; set BufMgrOptions::numShards to scale across cores.
+*/
+class BufMgr
+{
+
+    friend class PageHandle;
+    friend class BufReservation;
+
+private:
+    /**
+   * Number of frames in the buffer pool
+   * 缓冲池中的帧数
+	 */
+    std::uint32_t numBufs;
+
+    /**
+   * Number of shards the buffer pool is split into
+	 */
+    std::uint32_t numShards;
+
+    /**
+   * Frames reserved per shard, shard s owns the frames starting at s * framesPerShard
+	 */
+    std::uint32_t framesPerShard;
+
+    /**
+   * Array of shards, each with its own latch, clock hand and hash partition
+   * 每个分片拥有独立的锁、时针和哈希表
+	 */
+    BufShard *shards;
+
+    /**
+   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+   * BufDesc对象的数组，用于保存与“ bufPool”（缓冲池）中的每个帧分配相对应的信息
+	 */
+    BufDesc *bufDescTable;
+
+    /**
+   * Settings the pool was constructed with
+	 */
+    BufMgrOptions options;
+
+    /**
+   * Protects reservedFrames
+	 */
+    std::mutex reservationLatch;
+
+    /**
+   * Sum of the quotas of all live reservations
+	 */
+    std::uint32_t reservedFrames;
+
+    /**
+   * Background writer thread, only started if BufMgrOptions::backgroundWriter is set
+	 */
+    std::thread writer;
+
+    /**
+   * Protects writerStop
+	 */
+    std::mutex writerMutex;
+
+    /**
+   * Wakes the writer up early when it has to stop
+	 */
+    std::condition_variable writerWakeup;
+
+    /**
+   * Set by the destructor to end the writer thread
+	 */
+    bool writerStop;
+
+    /**
+   * Read-ahead thread, only started if BufMgrOptions::readAheadPages is not 0
+	 */
+    std::thread prefetcher;
+
+    /**
+   * Protects the read-ahead members below
+	 */
+    std::mutex readAheadLatch;
+
+    /**
+   * Wakes the read-ahead thread up for new requests or to stop
+	 */
+    std::condition_variable readAheadWakeup;
+
+    /**
+   * Signalled whenever the read-ahead thread finishes a request
+	 */
+    std::condition_variable readAheadDone;
+
+    /**
+   * Requests waiting for the read-ahead thread
+	 */
+    std::deque<ReadAheadRequest> readAheadQueue;
+
+    /**
+   * File of the request the read-ahead thread is working on, File::INVALID_ID if idle
+	 */
+    FileId readAheadFile;
+
+    /**
+   * Sequential access detection state of every file read so far
+	 */
+    std::unordered_map<FileId, ReadAheadState> readAheadStates;
+
+    /**
+   * Copies of the files read ahead, owned by the buffer manager so queued requests and the
+   * frames they fill never refer to a File object of the caller.  Closed by flushFile() or
+   * the destructor.
+	 */
+    std::map<FileId, File *> readAheadFiles;
+
+    /**
+   * Reads of sequential scans that missed the pages read ahead
+	 */
+    int readAheadMisses;
+
+    /**
+   * Set by the destructor to end the read-ahead thread
+	 */
+    bool readAheadStop;
+
+    /**
+   * Warm restart thread, only started if BufMgrOptions::warmStartFile is set
+	 */
+    std::thread warmer;
+
+    /**
+   * Protects the warm restart members below
+	 */
+    std::mutex warmLatch;
+
+    /**
+   * Signalled whenever the warm restart finishes a file or ends
+	 */
+    std::condition_variable warmDone;
+
+    /**
+   * File whose pages are being reloaded, File::INVALID_ID if none
+	 */
+    FileId warmFile;
+
+    /**
+   * Names of files flushed since the reload started, their pages are not reloaded any more
+	 */
+    std::set<std::string> warmSkip;
+
+    /**
+   * Files opened by the buffer manager to reload their pages, closed by flushFile() or the destructor
+	 */
+    std::map<FileId, File *> warmFiles;
+
+    /**
+   * Number of loadPageSet() calls running
+	 */
+    std::uint32_t warmLoads;
+
+    /**
+   * True until the background reload started by the constructor is done
+	 */
+    bool warming;
+
+    /**
+   * Set by the destructor to end a reload early
+	 */
+    bool warmStop;
+
+    /**
+   * Maximum number of consecutive pages reloaded with one read
+	 */
+    static const std::uint32_t WARM_RUN_PAGES = 32;
+
+    /**
+   * Body of the warm restart thread
+	 */
+    void warmUp(const std::string path);
+
+    /**
+   * Reloads a run of consecutive pages of the file into free frames with one read
+	 *
+	 * @param file   	File object
+	 * @param first  	Number of the first page of the run
+	 * @param refbits  Saved reference bit of every page of the run
+	 * @param loaded  	Incremented by the number of pages reloaded
+	 * @return  			False once the pool has no free frame left or the reload has to stop.
+	 */
+    bool warmRun(File *file, const PageId first, const std::vector<bool> &refbits, std::uint32_t &loaded);
+
+    /**
+   * Stops reloading pages of the file and waits until no run of it is being read
+	 */
+    void cancelWarmUp(const File *file);
+
+    /**
+   * Main loop of the read-ahead thread
+	 */
+    void prefetcherLoop();
+
+    /**
+   * Reads the pages of a request into free frames, skipping resident pages
+	 */
+    void readAhead(const ReadAheadRequest &request);
+
+    /**
+   * Updates the sequential access detection of the file after a readPage() and
+	 * queues read-ahead when the file is being scanned.  Must be called without any latch held.
+	 * Detection waits until the read-ahead thread has read the used list of the file.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page that was read
+	 * @param miss  	True if the page had to be read from disk
+	 */
+    void noteRead(File *file, const PageId pageNo, const bool miss);
+
+    /**
+   * Queues a read-ahead request for the file, reading through the buffer manager's own copy
+	 * of it.  Must be called with readAheadLatch held.
+	 */
+    void queueReadAhead(File *file, const PageId first, const std::uint32_t count);
+
+    /**
+   * Drops queued read-ahead of the file and waits until none is in progress
+	 */
+    void cancelReadAhead(const File *file);
+
+    /**
+   * Closes the copy of the file made for read-ahead unless a request still uses it.
+	 * Called by flushFile() once no frame refers to the file any more.
+	 */
+    void dropReadAheadFile(const FileId fileId);
+
+    /**
+   * Main loop of the background writer thread
+	 */
+    void writerLoop();
+
+    /**
+   * Writes back up to max dirty unpinned frames among the next victims of the shard.
+	 * Must be called without any latch held.
+	 *
+	 * @return  Number of pages written
+	 */
+    std::uint32_t writeAhead(BufShard &shard, const std::uint32_t max);
+
+    /**
+   * Returns the shard caching the given page of the file
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+    BufShard &shardFor(const File *file, const PageId pageNo);
+
+    /**
+   * Returns the shard owning the given frame
+	 */
+    BufShard &shardOf(const FrameId frame);
+
+    /**
+   * Clock used to time disk I/O
+	 */
+    typedef std::chrono::steady_clock IOClock;
+
+    /**
+   * Returns the nanoseconds passed since start
+	 */
+    static std::uint64_t elapsedNs(const IOClock::time_point start);
+
+    /**
+   * Accounts pages read from the file with one call that took ns nanoseconds to the statistics
+	 * of the shard.  Must be called with the shard latch held.
+	 */
+    void countReads(BufShard &shard, const FileId fileId, const std::uint32_t pages, const std::uint64_t ns);
+
+    /**
+   * Accounts pages written to the file with one call that took ns nanoseconds to the statistics
+	 * of the shard.  Must be called with the shard latch held.
+	 */
+    void countWrites(BufShard &shard, const FileId fileId, const std::uint32_t pages, const std::uint64_t ns);
+
+    /**
+   * Writes a run of frames holding consecutive pages of the file with one call and empties the run.
+	 * Must be called with the latches of all shards held.
+	 */
+    void writeRun(File *file, std::vector<const Page *> &run);
+
+    /**
+	 * Allocate a free frame from the shard for the given page, evicting the victim chosen by
+	 * the shard's replacement policy.  Must be called with the shard latch held.
+	 *
+	 * @param shard   	Shard to allocate the frame from
+	 * @param guard   	Lock holding the shard latch, released while waiting for the background writer
+	 * @param file   	File of the page that is going to be loaded
+	 * @param pageNo  Number of the page that is going to be loaded
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @return  			True if the shard latch was released meanwhile; the page may have been loaded
+	 * 					by another thread then.
+	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 */
+    bool allocBuf(BufShard &shard, std::unique_lock<std::mutex> &guard, const File *file,
+                  const PageId pageNo, FrameId &frame);
+
+    /**
+	 * Looks for a clean frame among the next BufMgrOptions::cleanFirstWindow victims of the
+	 * shard's policy through ReplacementPolicy::pickCleanVictim().  Must be called with the shard latch held.
+	 *
+	 * @param shard   	Shard to search
+	 * @param frame   	Frame reference, frame ID of the clean victim returned via this variable
+	 * @return  			False if all the candidates are dirty.
+	 */
+    bool pickCleanVictim(BufShard &shard, FrameId &frame);
+
+    /**
+	 * Increment the pin count of a frame of the shard, keeping BufShard::numPinned up to date.
+	 * Must be called with the shard latch held.
+	 */
+    void pinFrame(BufShard &shard, const FrameId frame);
+
+    /**
+	 * Decrement the pin count of a frame of the shard and mark it dirty, keeping BufShard::numPinned
+	 * up to date.  Needs no latch, the frame can not change its page while it is pinned.
+	 *
+	 * @return  			False if the frame was not pinned.
+	 */
+    bool unpinFrame(BufShard &shard, const FrameId frame, const bool dirty);
+
+    /**
+	 * Ends the read of a page into a frame of the shard started by loadFrame() and wakes up the
+	 * threads waiting for it.  If the read failed the frame is emptied.  Must be called with
+	 * the shard latch held.
+	 */
+    void finishRead(BufShard &shard, const FrameId frame, const bool ok);
+
+    /**
+	 * Assign a frame of the shard to a page: set its descriptor, pin it and tell the policy.
+	 * Must be called with the shard latch held.
+	 */
+    void loadFrame(BufShard &shard, const FrameId frame, File *file, const PageId pageNo);
+
+    /**
+	 * Empty a frame of the shard that is not being evicted and put it on the free list.
+	 * The caller removes the page from the page table.  Must be called with the shard latch held.
+	 */
+    void freeFrame(BufShard &shard, const FrameId frame);
+
+    /**
+	 * Write back the page of a frame of the shard chosen as victim if it is dirty, remove it from
+	 * the page table and clear the frame.  Must be called with the shard latch held.
+	 */
+    void evictFrame(BufShard &shard, const FrameId frame);
+
+    /**
+	 * Adds frames at the tail of the shard.  Must be called with the shard latch held.
+	 */
+    void growShard(BufShard &shard, const std::uint32_t numFrames);
+
+    /**
+	 * Evicts the pages of the frames at the tail of the shard and drops the frames.
+	 * The caller checked that none of them is pinned.  Must be called with the shard latch held.
+	 */
+    void shrinkShard(BufShard &shard, const std::uint32_t numFrames);
+
+    /**
+	 * Number of frames shard s owns in a pool of bufs frames
+	 */
+    std::uint32_t shardSize(const std::uint32_t s, const std::uint32_t bufs) const;
+
+    /**
+	 * Sets the memory policy of a page aligned range to prefer the given NUMA node.
+	 * Has to be called before the memory is first touched.
+	 *
+	 * @return  			False if the policy could not be set.
+	 */
+    static bool bindToNode(void *addr, const std::size_t length, const int node);
+
+    /**
+	 * Remove the page held by a frame of the shard from the page table and the per-file index.
+	 * Must be called with the shard latch held.
+	 */
+    void unmapFrame(BufShard &shard, const FrameId frame);
+
+    /**
+	 * Take the frame at the cursor of the strategy's ring of the shard for a new page, if the
+	 * ring is full and the frame still holds, unpinned, the page the scan loaded into it.
+	 * Must be called with the shard latch held.
+	 *
+	 * @return  True if the frame was emptied and returned via frame
+	 */
+    bool reuseRingFrame(BufShard &shard, BufAccessStrategy &strategy, FrameId &frame);
+
+    /**
+	 * Record a frame the scan using the strategy just loaded a page into as the ring slot at
+	 * the cursor, or as a new slot while the ring is not full.  Must be called with the shard latch held.
+	 */
+    void rememberRingFrame(BufShard &shard, BufAccessStrategy &strategy, const FrameId frame);
+
+    /**
+	 * Unpin a page through its frame, used by PageHandle instead of a page table lookup.
+	 *
+	 * @param frame   	Frame the page is cached in
+	 * @param dirty		True if the page needs to be marked dirty
+	 */
+    void unpinByFrame(const FrameId frame, const bool dirty);
+
+public:
+    /**
+   * Actual buffer pool from which frames are allocated.  All frames live in one
+   * arena aligned to FRAME_ALIGNMENT, so every frame starts on a page boundary.
+	 */
+    Page *bufPool;
+
+    /**
+   * Alignment of the frame arena, the size of a memory page
+	 */
+    static const std::size_t FRAME_ALIGNMENT = 4096;
+
+    /**
+   * Alignment and size granularity of the frame arena with BufMgrOptions::hugePages
+	 */
+    static const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    /**
+   * Constructor of BufMgr class
+	 *
+	 * @param bufs   	Number of frames in the buffer pool
+	 * @param options Construction time settings, see BufMgrOptions
+	 */
+    BufMgr(std::uint32_t bufs, const BufMgrOptions &options = BufMgrOptions());
+
+    /**
+   * Destructor of BufMgr class
+	 */
+    ~BufMgr();
+
+    /**
+	 * Reads the given page from the file into a frame and returns the pointer to page.
+	 * If the requested page is already present in the buffer pool pointer to that frame is returned
+	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param strategy  Ring of frames to load the page into on a miss, NULL to use the whole pool
+	 * @param reservation  Reservation to charge the pin to, NULL if none
+	 * @throws BufferBudgetExceededException If the reservation has no frame left
+	 */
+    void readPage(File *file, const PageId PageNo, Page *&page, BufAccessStrategy *strategy = NULL,
+                  BufReservation *reservation = NULL);
+
+    /**
+	 * Reads the given page like readPage(File *, const PageId, Page *&, BufAccessStrategy *) and
+	 * returns it pinned in a handle that unpins it when it goes away.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param strategy  Ring of frames to load the page into on a miss, NULL to use the whole pool
+	 * @param reservation  Reservation to charge the pin to until the handle releases it, NULL if none
+	 * @return  			Handle holding the pinned page
+	 */
+    PageHandle readPage(File *file, const PageId PageNo, BufAccessStrategy *strategy = NULL,
+                        BufReservation *reservation = NULL);
+
+    /**
+	 * Pins the given page and returns the pointer to it only if it is already present in the buffer pool.
+	 * Never reads from disk and never throws on a miss.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file
+	 * @param page  	Reference to page pointer, only set when the page is present
+	 * @return  			True if the page was present and has been pinned
+	 */
+    bool probePage(File *file, const PageId PageNo, Page *&page);
+
+    /**
+	 * Unpin a page from memory since it is no longer required for it to remain in memory.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+	 * @param reservation  Reservation the pin was charged to, NULL if none
+   * @throws  PageNotPinnedException If the page is not already pinned
+	 */
+    void unPinPage(File *file, const PageId PageNo, const bool dirty, BufReservation *reservation = NULL);
+
+    /**
+	 * Unpin a page like unPinPage(), reporting a page that is absent or not pinned through the return value.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty
+	 * @return  			True if the page was present and pinned, false otherwise
+	 */
+    bool tryUnPinPage(File *file, const PageId PageNo, const bool dirty);
+
+    /**
+	 * Allocates a new, empty page in the file and returns the Page object.
+	 * The newly allocated page is also assigned a frame in the buffer pool.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 * @param reservation  Reservation to charge the pin to, NULL if none
+	 * @throws BufferBudgetExceededException If the reservation has no frame left
+	 */
+    void allocPage(File *file, PageId &PageNo, Page *&page, BufReservation *reservation = NULL);
+
+    /**
+	 * Allocates a new page like allocPage(File *, PageId &, Page *&) and returns it pinned in a
+	 * handle that unpins it when it goes away.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param reservation  Reservation to charge the pin to until the handle releases it, NULL if none
+	 * @return  			Handle holding the pinned page
+	 */
+    PageHandle allocPage(File *file, PageId &PageNo, BufReservation *reservation = NULL);
+
+    /**
+	 * Tells the buffer manager whether the file is about to be read along its used page
+	 * chain, so read-ahead starts with the first page instead of waiting for detection.
+	 * Has no effect unless BufMgrOptions::readAheadPages is set.
+	 *
+	 * @param file   	File object
+	 * @param sequential  True when a scan starts, false when it ends
+	 */
+    void hintSequential(File *file, const bool sequential);
+
+    /**
+	 * Frees up to count frames in one sweep before a bulk operation, such as a table
+	 * load or the result of a join, allocates its pages.  Clean victims are evicted
+	 * before dirty ones, and the dirty ones are written back by this call instead of
+	 * one by one by the later misses.  The frames are put on the free lists of their
+	 * shards, they are not held for the caller, so concurrent misses may use them.
+	 *
+	 * @param count  	Number of frames wanted, spread over the shards
+	 * @return  			Number of free frames in the pool afterwards
+	 */
+    std::uint32_t reserveVictims(const std::uint32_t count);
+
+    /**
+	 * Writes out all dirty pages of the file to disk in ascending page order and
+	 * removes the pages of the file from the buffer pool.  Pending read-ahead of
+	 * the file is cancelled, so the file may be closed afterwards.
+	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
+	 * Otherwise Error returned.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 */
+    void flushFile(const File *file);
+
+    /**
+	 * Writes out the dirty pages of the file that are not pinned and forces the file to
+	 * stable storage with File::sync(), according to the durability of the file.  Unlike
+	 * flushFile() the pages stay in the buffer pool.  Pages pinned at the time are left
+	 * dirty, their changes are not complete yet.
+	 *
+	 * @param file   	File object
+	 * @throws FileIOException If writing or syncing the file fails
+	 */
+    void sync(const File *file);
+
+    /**
+	 * Delete page from file and also from buffer pool if present.
+	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 * Costs a few page header reads and writes, File::deletePage() does not walk the file.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @throws PagePinnedException If the page is pinned in the buffer pool, nothing is deleted then
+	 */
+    void disposePage(File *file, const PageId PageNo);
+
+    /**
+	 * Saves the (filename, pageNo) of every resident page together with its reference bit,
+	 * sorted by file and page so the pages can be reloaded with sequential reads.
+	 *
+	 * @param path   	Name of the page set file, replaced atomically
+	 * @return  			False if the file could not be written.
+	 */
+    bool savePageSet(const std::string &path);
+
+    /**
+	 * Reloads the pages listed in a page set file written by savePageSet() into free frames,
+	 * reading runs of consecutive pages with one call.  Pages already resident, deleted since or
+	 * of missing files are skipped; loading stops when the pool has no free frame left.  The files
+	 * are opened by the buffer manager and stay open until flushFile() drops their pages while no
+	 * reload runs, or the buffer manager is destroyed.  Only one reload may run at a time.
+	 *
+	 * @param path   	Name of the page set file
+	 * @return  			Number of pages reloaded.
+	 */
+    std::uint32_t loadPageSet(const std::string &path);
+
+    /**
+	 * Waits until the background reload started for BufMgrOptions::warmStartFile is done
+	 */
+    void waitForWarmUp();
+
+    /**
+	 * Grows or shrinks the buffer pool while it is in use.  Growing adds free frames
+	 * to every shard; the page tables are rehashed incrementally by later calls.
+	 * Shrinking evicts the pages of the frames at the tail of every shard, writing
+	 * dirty ones back.  If any of those frames is pinned the pool is left unchanged.
+	 *
+	 * @param bufs   	New number of frames in the buffer pool
+   * @throws  BufferExceededException If bufs exceeds BufMgrOptions::maxBufs, is smaller than the
+   *          number of shards or smaller than the frames held by reservations
+   * @throws  PagePinnedException If a frame that would be dropped is pinned
+	 */
+    void resize(const std::uint32_t bufs);
+
+    /**
+	 * Returns the current number of frames in the buffer pool
+	 */
+    std::uint32_t size();
+
+    /**
+	 * Returns the NUMA node the frame caching the given page of the file is bound
+	 * to, -1 if the frames are not bound.  The page does not need to be resident.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+    int pageNode(const File *file, const PageId pageNo);
+
+    /**
+	 * Returns the online NUMA nodes of the host, empty if they can not be determined
+	 */
+    static std::vector<int> numaNodes();
+
+    /**
+   * Print member variable values. 
+	 */
+    void printSelf();
+
+    /**
+   * Get buffer pool usage statistics, summed over all shards
+	 */
+    BufStats getBufStats();
+
+    /**
+   * Clear buffer pool usage statistics
+	 */
+    void clearBufStats();
+
+    /**
+   * Get number of shards the buffer pool is split into
+	 */
+    std::uint32_t getNumShards() const { return numShards; }
 };
 
 } // namespace badgerdb
@@ -0,0 +1,22 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "buffer_budget_exceeded_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+BufferBudgetExceededException::BufferBudgetExceededException(std::uint32_t quotaIn)
+    : BadgerDbException(""), quota(quotaIn) {
+  std::stringstream ss;
+  ss << "Exceeded the buffer reservation of " << quota << " frames";
+  message_.assign(ss.str());
+}
+
+}
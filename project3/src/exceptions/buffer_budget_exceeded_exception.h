@@ -0,0 +1,34 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a pin would take a buffer reservation over its quota.
+ */
+class BufferBudgetExceededException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a buffer budget exceeded exception for a reservation of the given number of frames.
+   */
+  explicit BufferBudgetExceededException(std::uint32_t quotaIn);
+
+ protected:
+  /**
+   * Number of frames the reservation may pin at once
+   */
+  const std::uint32_t quota;
+};
+
+}
@@ -0,0 +1,26 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "file_format_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+FileFormatException::FileFormatException(const std::string& name, const std::uint32_t version)
+    : BadgerDbException(""), filename_(name), version_(version) {
+  std::stringstream ss;
+  if (version_ == 0) {
+    ss << "File '" << filename_ << "' is not a BadgerDB file or is damaged";
+  } else {
+    ss << "File '" << filename_ << "' has unsupported format version " << version_;
+  }
+  message_.assign(ss.str());
+}
+
+}
@@ -0,0 +1,60 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a file is opened whose on-disk
+ *        format is not recognized or is a version this code does not support.
+ */
+class FileFormatException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a file format exception for the given file.
+   *
+   * @param name      Name of file that was opened.
+   * @param version   Format version found in the file header, 0 if the file
+   *                  is not recognized at all.
+   */
+  FileFormatException(const std::string& name, const std::uint32_t version);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~FileFormatException() throw() {}
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+  /**
+   * Returns the format version found in the file, 0 if not recognized.
+   */
+  virtual std::uint32_t version() const { return version_; }
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string filename_;
+
+  /**
+   * Format version found in the file header.
+   */
+  const std::uint32_t version_;
+};
+
+}
@@ -45,11 +45,13 @@ void TableScanner::print() const
     cout << names.str() << endl;
     cout << header.str() << endl;
 
-    Page *nowPage;
+    // a scan only cycles through a small ring of frames, the rest of the pool keeps its pages
+    BufAccessStrategy ring;
+    bufMgr->hintSequential(&file, true);
     for (FileIterator it = file.begin(); it != file.end(); it++)
     {
         PageId nowPageNumber = (*it).page_number();
-        bufMgr->readPage(&file, nowPageNumber, nowPage);
+        PageHandle nowPage = bufMgr->readPage(&file, nowPageNumber, &ring);
         SlotId nowSlotNumber = nowPage->begin().getNextUsedSlot(0);
         while (nowSlotNumber)
         {
@@ -73,9 +75,9 @@ void TableScanner::print() const
             cout << printStr << endl;
             nowSlotNumber = nowPage->begin().getNextUsedSlot(nowSlotNumber);
         }
-        bufMgr->unPinPage(&file, nowPageNumber, false);
-        bufMgr->flushFile(&file);
     }
+    bufMgr->hintSequential(&file, false);
+    bufMgr->flushFile(&file);
 }
 
 bool check(const File &leftTableFile, const File &rightTableFile)
@@ -233,7 +235,6 @@ int join(File file, Page *page, const TableSchema &resultable,
             }
         }
     }
-    bufMgr->unPinPage(&file, nowPageNumber, true);
     bufMgr->flushFile(&file);
     return numResultTuples;
 }
@@ -263,27 +264,33 @@ bool OnePassJoinOperator::execute(int numAvailableBufPages, File &resultFile)
     numResultTuples = 0;
     numUsedBufPages = 0;
     numIOs = 0;
+    // I/Os are measured by the buffer manager
+    const BufStats before = bufMgr->getBufStats();
     finding.clear();
+    BufAccessStrategy ring;
+    // the operator may keep at most numAvailableBufPages pages pinned
+    BufReservation budget(bufMgr, numAvailableBufPages);
+    bufMgr->hintSequential(&lfile, true);
     for (FileIterator it = lfile.begin(); it != lfile.end(); it++)
     {
-        Page *nowPage;
-        bufMgr->readPage(&lfile, (*it).page_number(), nowPage);
-        numIOs++;
-        build(nowPage, bufMgr, ltable);
+        PageHandle nowPage = bufMgr->readPage(&lfile, (*it).page_number(), &ring, &budget);
+        build(nowPage.get(), bufMgr, ltable);
         numUsedBufPages++;
-        bufMgr->unPinPage(&lfile, (*it).page_number(), false);
-        bufMgr->flushFile(&lfile);
     }
+    bufMgr->hintSequential(&lfile, false);
+    bufMgr->flushFile(&lfile);
+    // free frames for the result pages in one sweep before the probe phase
+    bufMgr->reserveVictims(numAvailableBufPages);
+    bufMgr->hintSequential(&rfile, true);
     for (FileIterator it = rfile.begin(); it != rfile.end(); it++)
     {
-        Page *nowPage;
-        bufMgr->readPage(&rfile, (*it).page_number(), nowPage);
-        numIOs++;
-        numResultTuples += join(resultFile, nowPage, restable, rtable, catalog, bufMgr);
-        bufMgr->unPinPage(&rfile, (*it).page_number(), false);
-        bufMgr->flushFile(&rfile);
+        PageHandle nowPage = bufMgr->readPage(&rfile, (*it).page_number(), &ring, &budget);
+        numResultTuples += join(resultFile, nowPage.get(), restable, rtable, catalog, bufMgr);
     }
+    bufMgr->hintSequential(&rfile, false);
+    bufMgr->flushFile(&rfile);
     numUsedBufPages++;
+    numIOs = bufMgr->getBufStats().diskIOs() - before.diskIOs();
     isComplete = true;
     return true;
 }
@@ -306,38 +313,37 @@ bool NestedLoopJoinOperator::execute(int numAvailableBufPages, File &resultFile)
     numResultTuples = 0;
     numUsedBufPages = 0;
     numIOs = 0;
+    const BufStats before = bufMgr->getBufStats();
     int size = numAvailableBufPages - 1;
+    BufReservation budget(bufMgr, numAvailableBufPages);
+    // free frames for the result pages in one sweep before the join starts
+    bufMgr->reserveVictims(numAvailableBufPages);
     finding.clear();
     FileIterator it = lfile.begin();
     while (it != lfile.end())
     {
         for (int i = 0; i < size && it != lfile.end(); it++)
         {
-            Page *nowPage;
-            bufMgr->readPage(&lfile, (*it).page_number(), nowPage);
-            numUsedBufPages++;
-            build(nowPage, bufMgr, ltable);
-            bufMgr->unPinPage(&lfile, (*it).page_number(), false);
+            {
+                PageHandle nowPage = bufMgr->readPage(&lfile, (*it).page_number(), NULL, &budget);
+                numUsedBufPages++;
+                build(nowPage.get(), bufMgr, ltable);
+            }
             bufMgr->flushFile(&lfile);
         }
 
+        bufMgr->hintSequential(&rfile, true);
         for (FileIterator rit = rfile.begin(); rit != rfile.end(); rit++)
         {
-            Page *nowPage;
-            bufMgr->readPage(&rfile, (*rit).page_number(), nowPage);
-            numResultTuples += join(resultFile, nowPage, restable, rtable, catalog, bufMgr);
-            bufMgr->unPinPage(&rfile, (*rit).page_number(), false);
-            bufMgr->flushFile(&rfile);
+            PageHandle nowPage = bufMgr->readPage(&rfile, (*rit).page_number(), NULL, &budget);
+            numResultTuples += join(resultFile, nowPage.get(), restable, rtable, catalog, bufMgr);
         }
+        bufMgr->hintSequential(&rfile, false);
+        bufMgr->flushFile(&rfile);
         finding.clear();
     }
     numUsedBufPages++;
-    int left_count = 0, right_count = 0;
-    for (it = lfile.begin(); it != lfile.end(); it++)
-        left_count++;
-    for (it = rfile.begin(); it != rfile.end(); it++)
-        right_count++;
-    numIOs = left_count + (left_count * right_count) / (numAvailableBufPages - 1);
+    numIOs = bufMgr->getBufStats().diskIOs() - before.diskIOs();
     isComplete = true;
     return true;
 }
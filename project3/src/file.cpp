@@ -7,14 +7,20 @@
 
 #include "file.h"
 
-#include <fstream>
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <cstdio>
 #include <cassert>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_format_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
@@ -24,8 +30,11 @@
 namespace badgerdb
 {
 
-File::StreamMap File::open_streams_;
+File::OpenFileMap File::open_files_;
+std::mutex File::open_files_latch_;
 File::CountMap File::open_counts_;
+File::IdMap File::file_ids_;
+FileId File::next_file_id_ = File::INVALID_ID + 1;
 
 File File::create(const std::string &filename)
 {
@@ -43,11 +52,14 @@ void File::remove(const std::string &filename)
     {
         throw FileNotFoundException(filename);
     }
-    if (isOpen(filename))
+    std::lock_guard<std::mutex> registry(open_files_latch_);
+    if (open_counts_.find(filename) != open_counts_.end())
     {
         throw FileOpenException(filename);
     }
     std::remove(filename.c_str());
+    // a file created later under the same name must not inherit cached pages
+    file_ids_.erase(filename);
 }
 
 bool File::isOpen(const std::string &filename)
@@ -56,25 +68,21 @@ bool File::isOpen(const std::string &filename)
     {
         return false;
     }
+    std::lock_guard<std::mutex> registry(open_files_latch_);
     return open_counts_.find(filename) != open_counts_.end();
 }
 
 bool File::exists(const std::string &filename)
 {
-    std::fstream file(filename);
-    if (file)
-    {
-        file.close();
-        return true;
-    }
-
-    return false;
+    return ::access(filename.c_str(), F_OK) == 0;
 }
 
 File::File(const File &other)
     : filename_(other.filename_),
-      stream_(open_streams_[filename_])
+      id_(other.id_),
+      state_(other.state_)
 {
+    std::lock_guard<std::mutex> registry(open_files_latch_);
     ++open_counts_[filename_];
 }
 
@@ -95,9 +103,9 @@ File::~File()
 
 Page File::allocatePage()
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->latch);
     FileHeader header = readHeader();
     Page new_page;
-    Page existing_page;
     if (header.num_free_pages > 0)
     {
         new_page = readPage(header.first_free_page, true /* allow_free */);
@@ -105,101 +113,86 @@ Page File::allocatePage()
         header.first_free_page = new_page.next_page_number();
         --header.num_free_pages;
 
-        if (header.first_used_page == Page::INVALID_NUMBER ||
-            header.first_used_page > new_page.page_number())
-        {
-            // Either have no pages used or the head of the used list is a page later
-            // than the one we just allocated, so add the new page to the head.
-            if (header.first_used_page > new_page.page_number())
-            {
-                new_page.set_next_page_number(header.first_used_page);
-            }
-            header.first_used_page = new_page.page_number();
-        }
-        else
-        {
-            // New page is reused from somewhere after the beginning, so we need to
-            // find where in the used list to insert it.
-            PageId next_page_number = Page::INVALID_NUMBER;
-            for (FileIterator iter = begin(); iter != end(); ++iter)
-            {
-                next_page_number = (*iter).next_page_number();
-                if (next_page_number > new_page.page_number() ||
-                    next_page_number == Page::INVALID_NUMBER)
-                {
-                    existing_page = *iter;
-                    break;
-                }
-            }
-            existing_page.set_next_page_number(new_page.page_number());
-            new_page.set_next_page_number(next_page_number);
-        }
-
         assert((header.num_free_pages == 0) ==
                (header.first_free_page == Page::INVALID_NUMBER));
     }
     else
     {
         new_page.set_page_number(header.num_pages);
-        if (header.first_used_page == Page::INVALID_NUMBER)
-        {
-            header.first_used_page = new_page.page_number();
-        }
-        else
-        {
-            // If we have pages allocated, we need to add the new page to the tail
-            // of the linked list.
-            for (FileIterator iter = begin(); iter != end(); ++iter)
-            {
-                if ((*iter).next_page_number() == Page::INVALID_NUMBER)
-                {
-                    existing_page = *iter;
-                    break;
-                }
-            }
-            assert(existing_page.isUsed());
-            existing_page.set_next_page_number(new_page.page_number());
-        }
         ++header.num_pages;
     }
+    linkUsedPage(header, new_page);
     writePage(new_page.page_number(), new_page);
-    if (existing_page.page_number() != Page::INVALID_NUMBER)
-    {
-        // If we updated an existing page by inserting the new page into the
-        // used list, we need to write it out.
-        writePage(existing_page.page_number(), existing_page);
-    }
     writeHeader(header);
+    syncIfPerWrite();
 
     return new_page;
 }
 
 Page File::readPage(const PageId page_number) const
+{
+    Page page;
+    readPageInto(page_number, page);
+    return page;
+}
+
+void File::readPageInto(const PageId page_number, Page &page) const
 {
     FileHeader header = readHeader();
     if (page_number >= header.num_pages)
     {
         throw InvalidPageException(page_number, filename_);
     }
-    return readPage(page_number, false /* allow_free */);
+    readPageInto(page_number, page, false /* allow_free */);
+}
+
+void File::readPages(const PageId first, std::vector<Page *> &pages) const
+{
+    const FileHeader header = readHeader();
+    // pages past the end of the file are not read at all
+    std::size_t count = 0;
+    while (count < pages.size() && first + count < header.num_pages)
+        count++;
+    for (std::size_t i = count; i < pages.size(); i++)
+        pages[i] = NULL;
+    if (count == 0)
+        return;
+    std::string buffer(count * Page::SIZE, '\0');
+    readAt(&buffer[0], buffer.size(), pagePosition(first));
+    for (std::size_t i = 0; i < count; i++)
+    {
+        std::copy(&buffer[i * Page::SIZE], &buffer[i * Page::SIZE] + Page::SIZE,
+                  reinterpret_cast<char *>(pages[i]));
+        if (!pages[i]->isUsed())
+            pages[i] = NULL;
+    }
 }
 
 Page File::readPage(const PageId page_number, const bool allow_free) const
 {
     Page page;
-    stream_->seekg(pagePosition(page_number), std::ios::beg);
-    stream_->read(reinterpret_cast<char *>(&page.header_), sizeof(page.header_));
-    stream_->read(reinterpret_cast<char *>(&page.data_[0]), Page::DATA_SIZE);
+    readPageInto(page_number, page, allow_free);
+    return page;
+}
+
+void File::readPageInto(const PageId page_number, Page &page, const bool allow_free) const
+{
+    // a page has the same layout in memory as on disk
+    readAt(&page, Page::SIZE, pagePosition(page_number));
     if (!allow_free && !page.isUsed())
     {
         throw InvalidPageException(page_number, filename_);
     }
-
-    return page;
 }
 
 void File::writePage(const Page &new_page)
 {
+    writePageFrom(new_page);
+}
+
+void File::writePageFrom(const Page &new_page)
+{
+    std::lock_guard<std::recursive_mutex> lock(state_->latch);
     PageHeader header = readPageHeader(new_page.page_number());
     if (header.current_page_number == Page::INVALID_NUMBER)
     {
@@ -213,43 +206,126 @@ void File::writePage(const Page &new_page)
     header = new_page.header_;
     header.next_page_number = next_page_number;
     writePage(new_page.page_number(), header, new_page);
+    syncIfPerWrite();
+}
+
+void File::writePages(const std::vector<const Page *> &pages)
+{
+    std::lock_guard<std::recursive_mutex> lock(state_->latch);
+    if (pages.empty())
+        return;
+    std::string buffer(pages.size() * Page::SIZE, '\0');
+    for (std::size_t i = 0; i < pages.size(); i++)
+    {
+        const Page *new_page = pages[i];
+        assert(new_page->page_number() == pages[0]->page_number() + i);
+        PageHeader header = readPageHeader(new_page->page_number());
+        if (header.current_page_number == Page::INVALID_NUMBER)
+        {
+            throw InvalidPageException(new_page->page_number(), filename_);
+        }
+        // keep the on-disk next page pointer, as writePage(const Page &) does
+        const PageId next_page_number = header.next_page_number;
+        header = new_page->header_;
+        header.next_page_number = next_page_number;
+        char *slot = &buffer[i * Page::SIZE];
+        std::copy(reinterpret_cast<const char *>(&header),
+                  reinterpret_cast<const char *>(&header) + sizeof(header), slot);
+        std::copy(new_page->data_, new_page->data_ + Page::DATA_SIZE, slot + sizeof(header));
+    }
+    writeAt(buffer.data(), buffer.size(), pagePosition(pages[0]->page_number()));
+    syncIfPerWrite();
 }
 
 void File::deletePage(const PageId page_number)
 {
+    std::lock_guard<std::recursive_mutex> lock(state_->latch);
     FileHeader header = readHeader();
-    Page existing_page = readPage(page_number);
-    Page previous_page;
+    const PageHeader page_header = readPageHeader(page_number);
+    if (page_number >= header.num_pages ||
+        page_header.current_page_number == Page::INVALID_NUMBER)
+    {
+        throw InvalidPageException(page_number, filename_);
+    }
+    // The used list is ordered by page number, so the page pointing to this
+    // one is the used page with the next lower number.
+    std::set<PageId> &used = usedPages();
+    std::set<PageId>::iterator it = used.find(page_number);
+    assert(it != used.end());
+    PageId previous_page_number = Page::INVALID_NUMBER;
+    if (it != used.begin())
+    {
+        std::set<PageId>::iterator previous = it;
+        previous_page_number = *--previous;
+    }
     // If this page is the head of the used list, update the header to point to
-    // the next page in line.
-    if (page_number == header.first_used_page)
+    // the next page in line; otherwise only the page header of its predecessor
+    // changes.
+    if (previous_page_number == Page::INVALID_NUMBER)
     {
-        header.first_used_page = existing_page.next_page_number();
+        header.first_used_page = page_header.next_page_number;
     }
     else
     {
-        // Walk the used list so we can update the page that points to this one.
-        for (FileIterator iter = begin(); iter != end(); ++iter)
-        {
-            previous_page = *iter;
-            if (previous_page.next_page_number() == existing_page.page_number())
-            {
-                previous_page.set_next_page_number(existing_page.next_page_number());
-                break;
-            }
-        }
+        setNextPageNumber(previous_page_number, page_header.next_page_number);
+    }
+    if (page_number == header.last_used_page)
+    {
+        header.last_used_page = previous_page_number;
     }
+    used.erase(it);
     // Clear the page and add it to the head of the free list.
-    existing_page.initialize();
-    existing_page.set_next_page_number(header.first_free_page);
+    Page free_page;
+    free_page.set_next_page_number(header.first_free_page);
     header.first_free_page = page_number;
     ++header.num_free_pages;
-    if (previous_page.isUsed())
+    writePage(page_number, free_page);
+    writeHeader(header);
+    syncIfPerWrite();
+}
+
+PageId File::nextUsedPage(const PageId page_number) const
+{
+    std::lock_guard<std::recursive_mutex> lock(state_->latch);
+    const std::set<PageId> &used = usedPages();
+    std::set<PageId>::const_iterator next = used.upper_bound(page_number);
+    return next == used.end() ? Page::INVALID_NUMBER : *next;
+}
+
+bool File::tryNextUsedPage(const PageId page_number, PageId &next) const
+{
+    std::lock_guard<std::recursive_mutex> lock(state_->latch);
+    if (!state_->used_pages_loaded)
+        return false;
+    next = nextUsedPage(page_number);
+    return true;
+}
+
+void File::sync() const
+{
+    flushHeader();
+    if (durability() == DURABILITY_NONE)
+        return;
+#ifdef __APPLE__
+    // macOS has no fdatasync()
+    const int result = ::fsync(state_->fd);
+#else
+    const int result = ::fdatasync(state_->fd);
+#endif
+    if (result != 0)
     {
-        writePage(previous_page.page_number(), previous_page);
+        throw FileIOException(filename_, errno);
     }
-    writePage(page_number, existing_page);
-    writeHeader(header);
+}
+
+void File::setDurability(const Durability durability)
+{
+    state_->durability = durability;
+}
+
+Durability File::durability() const
+{
+    return static_cast<Durability>(state_->durability.load());
 }
 
 FileIterator File::begin()
@@ -271,22 +347,26 @@ File::File(const std::string &name, const bool create_new) : filename_(name)
     {
         // File starts with 1 page (the header).
         FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                             0 /* num_free_pages */, 0 /* first_free_page */};
+                             0 /* num_free_pages */, 0 /* first_free_page */,
+                             0 /* last_used_page */, FileHeader::MAGIC,
+                             FileHeader::VERSION};
         writeHeader(header);
+        // a new file is valid on disk from the start
+        flushHeader();
     }
 }
 
 void File::openIfNeeded(const bool create_new)
 {
+    std::lock_guard<std::mutex> registry(open_files_latch_);
     if (open_counts_.find(filename_) != open_counts_.end())
     { //exists an entry already
         ++open_counts_[filename_];
-        stream_ = open_streams_[filename_];
+        state_ = open_files_[filename_];
     }
     else
     {
-        std::ios_base::openmode mode =
-            std::fstream::in | std::fstream::out | std::fstream::binary;
+        int flags = O_RDWR;
         const bool already_exists = exists(filename_);
         if (create_new)
         {
@@ -296,7 +376,7 @@ void File::openIfNeeded(const bool create_new)
                 throw FileExistsException(filename_);
             }
             // New files have to be truncated on open.
-            mode = mode | std::fstream::trunc;
+            flags |= O_CREAT | O_TRUNC;
         }
         else
         {
@@ -306,23 +386,51 @@ void File::openIfNeeded(const bool create_new)
                 throw FileNotFoundException(filename_);
             }
         }
-        stream_.reset(new std::fstream(filename_, mode));
-        open_streams_[filename_] = stream_;
+        const int fd = ::open(filename_.c_str(), flags, 0644);
+        if (fd < 0)
+        {
+            throw FileIOException(filename_, errno);
+        }
+        state_.reset(new OpenFile(fd));
+        if (!create_new)
+        {
+            readAt(&state_->header, sizeof(state_->header), 0 /* pos */);
+            checkFormat();
+        }
+        open_files_[filename_] = state_;
         open_counts_[filename_] = 1;
+        if (file_ids_.find(filename_) == file_ids_.end())
+        {
+            file_ids_[filename_] = next_file_id_++;
+        }
     }
+    id_ = file_ids_[filename_];
 }
 
 void File::close()
 {
+    std::lock_guard<std::mutex> registry(open_files_latch_);
     --open_counts_[filename_];
-    stream_.reset();
+    state_.reset();
     if (open_counts_[filename_] == 0)
     {
-        open_streams_.erase(filename_);
+        // the descriptor is closed with the last reference to it
+        open_files_.erase(filename_);
         open_counts_.erase(filename_);
     }
 }
 
+File::OpenFile::~OpenFile()
+{
+    // the last File object of the file is gone, nobody could handle an error
+    if (header_dirty)
+    {
+        ssize_t written = ::pwrite(fd, &header, sizeof(header), 0 /* pos */);
+        (void)written;
+    }
+    ::close(fd);
+}
+
 void File::writePage(const PageId page_number, const Page &new_page)
 {
     writePage(page_number, new_page.header_, new_page);
@@ -331,36 +439,245 @@ void File::writePage(const PageId page_number, const Page &new_page)
 void File::writePage(const PageId page_number, const PageHeader &header,
                      const Page &new_page)
 {
-    stream_->seekp(pagePosition(page_number), std::ios::beg);
-    stream_->write(reinterpret_cast<const char *>(&header), sizeof(header));
-    stream_->write(reinterpret_cast<const char *>(&new_page.data_[0]),
-                   Page::DATA_SIZE);
-    stream_->flush();
+    if (&header == &new_page.header_)
+    {
+        writeAt(&new_page, Page::SIZE, pagePosition(page_number));
+        return;
+    }
+    // header and contents go out with one write, so no reader sees half a page
+    char buffer[Page::SIZE];
+    std::copy(reinterpret_cast<const char *>(&header),
+              reinterpret_cast<const char *>(&header) + sizeof(header), buffer);
+    std::copy(new_page.data_, new_page.data_ + Page::DATA_SIZE, buffer + sizeof(header));
+    writeAt(buffer, Page::SIZE, pagePosition(page_number));
 }
 
 FileHeader File::readHeader() const
 {
-    FileHeader header;
-    stream_->seekg(0 /* pos */, std::ios::beg);
-    stream_->read(reinterpret_cast<char *>(&header), sizeof(header));
-
-    return header;
+    std::lock_guard<std::recursive_mutex> lock(state_->latch);
+    return state_->header;
 }
 
 void File::writeHeader(const FileHeader &header)
 {
-    stream_->seekp(0 /* pos */, std::ios::beg);
-    stream_->write(reinterpret_cast<const char *>(&header), sizeof(header));
-    stream_->flush();
+    std::lock_guard<std::recursive_mutex> lock(state_->latch);
+    state_->header = header;
+    state_->header_dirty = true;
+}
+
+void File::flushHeader() const
+{
+    std::lock_guard<std::recursive_mutex> lock(state_->latch);
+    if (!state_->header_dirty)
+        return;
+    writeAt(&state_->header, sizeof(state_->header), 0 /* pos */);
+    state_->header_dirty = false;
 }
 
 PageHeader File::readPageHeader(PageId page_number) const
 {
     PageHeader header;
-    stream_->seekg(pagePosition(page_number), std::ios::beg);
-    stream_->read(reinterpret_cast<char *>(&header), sizeof(header));
+    readAt(&header, sizeof(header), pagePosition(page_number));
 
     return header;
 }
 
+void File::setNextPageNumber(const PageId page_number, const PageId next_page_number)
+{
+    PageHeader header = readPageHeader(page_number);
+    header.next_page_number = next_page_number;
+    writeAt(&header, sizeof(header), pagePosition(page_number));
+}
+
+void File::linkUsedPage(FileHeader &header, Page &page)
+{
+    const PageId page_number = page.page_number();
+    if (header.last_used_page == Page::INVALID_NUMBER ||
+        header.last_used_page < page_number)
+    {
+        // Appended at the tail of the used list, the common case.
+        page.set_next_page_number(Page::INVALID_NUMBER);
+        if (header.last_used_page == Page::INVALID_NUMBER)
+        {
+            header.first_used_page = page_number;
+        }
+        else
+        {
+            setNextPageNumber(header.last_used_page, page_number);
+        }
+        header.last_used_page = page_number;
+    }
+    else
+    {
+        // Inserted in the middle, between the used pages around its number.
+        std::set<PageId> &used = usedPages();
+        std::set<PageId>::iterator next = used.upper_bound(page_number);
+        page.set_next_page_number(*next);
+        if (next == used.begin())
+        {
+            header.first_used_page = page_number;
+        }
+        else
+        {
+            --next;
+            setNextPageNumber(*next, page_number);
+        }
+    }
+    if (state_->used_pages_loaded)
+    {
+        state_->used_pages.insert(page_number);
+    }
+}
+
+std::set<PageId> &File::usedPages() const
+{
+    if (!state_->used_pages_loaded)
+    {
+        for (PageId page_number = state_->header.first_used_page;
+             page_number != Page::INVALID_NUMBER;
+             page_number = readPageHeader(page_number).next_page_number)
+        {
+            state_->used_pages.insert(state_->used_pages.end(), page_number);
+        }
+        state_->used_pages_loaded = true;
+    }
+    return state_->used_pages;
+}
+
+void File::checkFormat()
+{
+    FileHeader &header = state_->header;
+    if (header.magic == FileHeader::MAGIC)
+    {
+        if (header.version != FileHeader::VERSION)
+        {
+            throw FileFormatException(filename_, header.version);
+        }
+        return;
+    }
+
+    // version 0 headers ended after first_free_page, followed by whole pages
+    const off_t old_header_size = 4 * sizeof(PageId);
+    struct stat info;
+    if (::fstat(state_->fd, &info) != 0)
+    {
+        throw FileIOException(filename_, errno);
+    }
+    if (info.st_size < old_header_size ||
+        (info.st_size - old_header_size) % Page::SIZE != 0 ||
+        header.num_pages != (info.st_size - old_header_size) / Page::SIZE + 1)
+    {
+        throw FileFormatException(filename_, 0);
+    }
+
+    // The original stays untouched until the complete copy replaces it.
+    const std::string upgraded_name = filename_ + ".upgrade";
+    const int upgraded_fd = ::open(upgraded_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (upgraded_fd < 0)
+    {
+        throw FileIOException(upgraded_name, errno);
+    }
+    FileHeader upgraded = header;
+    try
+    {
+        Page page;
+        for (PageId page_number = 1; page_number < header.num_pages; ++page_number)
+        {
+            readAt(&page, Page::SIZE, old_header_size + (off_t)(page_number - 1) * Page::SIZE);
+            writeAt(upgraded_fd, &page, Page::SIZE, pagePosition(page_number));
+        }
+        upgraded.last_used_page = Page::INVALID_NUMBER;
+        for (PageId page_number = header.first_used_page;
+             page_number != Page::INVALID_NUMBER && page_number < header.num_pages;)
+        {
+            upgraded.last_used_page = page_number;
+            PageHeader page_header;
+            readAt(&page_header, sizeof(page_header),
+                   old_header_size + (off_t)(page_number - 1) * Page::SIZE);
+            page_number = page_header.next_page_number;
+        }
+        upgraded.magic = FileHeader::MAGIC;
+        upgraded.version = FileHeader::VERSION;
+        writeAt(upgraded_fd, &upgraded, sizeof(upgraded), 0 /* pos */);
+        if (::fsync(upgraded_fd) != 0 || ::rename(upgraded_name.c_str(), filename_.c_str()) != 0)
+        {
+            throw FileIOException(upgraded_name, errno);
+        }
+    }
+    catch (...)
+    {
+        ::close(upgraded_fd);
+        ::unlink(upgraded_name.c_str());
+        throw;
+    }
+
+    // make the rename itself durable
+    const std::string::size_type slash = filename_.find_last_of('/');
+    const std::string directory = slash == std::string::npos ? "." : filename_.substr(0, slash + 1);
+    const int directory_fd = ::open(directory.c_str(), O_RDONLY);
+    if (directory_fd >= 0)
+    {
+        ::fsync(directory_fd);
+        ::close(directory_fd);
+    }
+
+    // the descriptor of the copy now refers to the file
+    ::close(state_->fd);
+    state_->fd = upgraded_fd;
+    header = upgraded;
+}
+
+void File::readAt(void *buffer, const std::size_t size, const off_t offset) const
+{
+    char *next = static_cast<char *>(buffer);
+    std::size_t left = size;
+    while (left > 0)
+    {
+        const ssize_t done = ::pread(state_->fd, next, left, offset + (next - static_cast<char *>(buffer)));
+        if (done < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw FileIOException(filename_, errno);
+        }
+        if (done == 0)
+        {
+            // past the end of the file
+            std::fill(next, next + left, 0);
+            return;
+        }
+        next += done;
+        left -= done;
+    }
+}
+
+void File::syncIfPerWrite() const
+{
+    if (durability() == DURABILITY_PER_WRITE)
+        sync();
+}
+
+void File::writeAt(const void *buffer, const std::size_t size, const off_t offset) const
+{
+    writeAt(state_->fd, buffer, size, offset);
+}
+
+void File::writeAt(const int fd, const void *buffer, const std::size_t size, const off_t offset) const
+{
+    const char *next = static_cast<const char *>(buffer);
+    std::size_t left = size;
+    while (left > 0)
+    {
+        const ssize_t done = ::pwrite(fd, next, left, offset + (next - static_cast<const char *>(buffer)));
+        if (done < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw FileIOException(filename_, errno);
+        }
+        next += done;
+        left -= done;
+    }
+}
+
 } // namespace badgerdb
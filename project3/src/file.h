@@ -7,10 +7,14 @@
 
 #pragma once
 
-#include <fstream>
+#include <atomic>
 #include <string>
 #include <map>
+#include <set>
 #include <memory>
+#include <mutex>
+#include <vector>
+#include <sys/types.h>
 
 #include "page.h"
 
@@ -19,11 +23,45 @@ namespace badgerdb
 
 class FileIterator;
 
+/**
+ * @brief When the changes written to a file are forced to stable storage.
+ */
+enum Durability
+{
+    /**
+   * Never, sync() does nothing.  For temporary files such as join results.
+   */
+    DURABILITY_NONE,
+
+    /**
+   * When sync() is called.  Writes only reach the operating system's cache
+   * until then.
+   */
+    DURABILITY_ON_SYNC,
+
+    /**
+   * After every call that changes the file, as well as by sync().  A page
+   * allocation or deletion costs one sync, not one per page it touches.
+   */
+    DURABILITY_PER_WRITE
+};
+
 /**
  * @brief Header metadata for files on disk which contain pages.
  */
 struct FileHeader
 {
+    /**
+   * Identifies files with a versioned header.  Files of version 0 had no
+   * last_used_page, magic and version fields; they are upgraded when opened.
+   */
+    static const std::uint32_t MAGIC = 0x46424442;
+
+    /**
+   * Version of the on-disk format written by this code.
+   */
+    static const std::uint32_t VERSION = 1;
+
     /**
    * Number of pages allocated in the file.
    * 这个文件请求的页面数目
@@ -48,6 +86,25 @@ struct FileHeader
    */
     PageId first_free_page;
 
+    /**
+   * Page number of the last used page in the file, so pages are appended to
+   * the used list without walking it.
+   * 最后一个使用的页面的编号
+   */
+    PageId last_used_page;
+
+    /**
+   * Always MAGIC.  In a version 0 file these bytes belong to the slot counts
+   * of page 1, which can never take this value.
+   */
+    std::uint32_t magic;
+
+    /**
+   * Version of the on-disk format of the file.
+   * 文件格式的版本号
+   */
+    std::uint32_t version;
+
     /**
    * Returns true if this file header is equal to the other.
    *
@@ -59,7 +116,10 @@ struct FileHeader
         return num_pages == rhs.num_pages &&
                num_free_pages == rhs.num_free_pages &&
                first_used_page == rhs.first_used_page &&
-               first_free_page == rhs.first_free_page;
+               first_free_page == rhs.first_free_page &&
+               last_used_page == rhs.last_used_page &&
+               magic == rhs.magic &&
+               version == rhs.version;
     }
 };
 
@@ -67,19 +127,26 @@ struct FileHeader
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
- * fixed-sized pages, and they never deallocate space (though they do reuse
- * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * The File class wraps a file descriptor of an underlying file on disk.  Files
+ * contain fixed-sized pages, and they never deallocate space (though they do
+ * reuse deleted pages if possible).  If multiple File objects refer to the same
+ * underlying file, they will share the descriptor.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking in the open_files_ map) and just returns a file object with
+ * the already opened descriptor for the file without actually opening the UNIX file again. 
  *
- * @warning This class is not threadsafe.
+ * Pages are read and written with positional I/O (pread/pwrite), so reads of
+ * pages of the same file may run in several threads at once.  Changes of the
+ * file header and of the page lists are serialized by a latch per file.
  */
 class File
 {
 public:
+    /**
+   * File id that is never assigned to an open file.
+   */
+    static const FileId INVALID_ID = 0;
+
     /**
    * Creates a new file.
    * 创建文件
@@ -90,16 +157,18 @@ public:
 
     /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same file descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_files_ map.
      * 打开名为fileName的文件并返回相应的File对象。它首先检查文件是否已经打开。如果已经打开，则创建的新File对象将使用相同的输入输出流来读取或写入已打开文件的文件。
      * 每当已打开的文件再次打开时，引用计数（File对象中的open_counts_静态变量）就会增加。 否则，实际上会打开UNIX文件。
-     * 与此文件对象关联的文件名和流被插入到open_streams_映射中。
+     * 与此文件对象关联的文件名和文件描述符被插入到open_files_映射中。
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  FileIOException         If the file can not be opened.
+   * @throws  FileFormatException     If the file's on-disk format is not supported.
    */
     static File open(const std::string &filename);
 
@@ -165,6 +234,29 @@ public:
    */
     Page readPage(const PageId page_number) const;
 
+    /**
+   * Reads an existing page from the file straight into the given page, for
+   * instance a buffer frame, without an intermediate copy.
+   * 将页面直接读入给定的内存（例如缓冲池中的帧）
+   * @param page_number   Number of page to read.
+   * @param page          Page the contents are read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.  The contents of page
+   *                                are undefined in that case.
+   */
+    void readPageInto(const PageId page_number, Page &page) const;
+
+    /**
+   * Reads a run of pages with consecutive page numbers using a single read
+   * call, for instance into buffer frames.
+   * 用一次读操作读取若干个编号连续的页面
+   * @param first   Number of the first page to read.
+   * @param pages   Pages the contents are read into, one per page number.
+   *                Entries of pages that do not exist or are not currently
+   *                used are set to NULL; their contents are undefined.
+   */
+    void readPages(const PageId first, std::vector<Page *> &pages) const;
+
     /**
    * Writes a page into the file, replacing any existing contents.  The page
    * must have been already allocated in this file by a call to allocatePage().
@@ -175,12 +267,75 @@ public:
     void writePage(const Page &new_page);
 
     /**
-   * Deletes a page from the file.
+   * Writes a page into the file straight from the given memory, for instance a
+   * buffer frame, like writePage(const Page &).
+   * 直接从给定的内存写入页面
+   * @param new_page  Page to write.
+   */
+    void writePageFrom(const Page &new_page);
+
+    /**
+   * Writes a run of pages with consecutive page numbers using a single write
+   * call.  Every page is written as by writePage(const Page &).
+   * 用一次写操作写入若干个编号连续的页面
+   * @param pages  Pages to write, sorted by page number without gaps.
+   * @throws  InvalidPageException  If one of the pages has been deleted; no
+   *                                page is written in that case.
+   */
+    void writePages(const std::vector<const Page *> &pages);
+
+    /**
+   * Deletes a page from the file.  The page before it in the used list is
+   * found in the set of used pages, so only its page header is rewritten.
    * 从文件中删除页面
    * @param page_number   Number of page to delete.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
    */
     void deletePage(const PageId page_number);
 
+    /**
+   * Returns the number of the used page following the given page in the used
+   * list, as it is on disk.  The next page numbers in copies of pages, such as
+   * buffer frames, are not kept up to date when the list changes.
+   * 返回已使用页面链表中的下一个页面编号
+   * @param page_number   Number of a page of the file.
+   * @return  Number of the next used page, Page::INVALID_NUMBER if there is none.
+   */
+    PageId nextUsedPage(const PageId page_number) const;
+
+    /**
+   * Like nextUsedPage(), but never reads the used list from disk.
+   *
+   * @param page_number   Number of a page of the file.
+   * @param next          Number of the next used page returned via this variable.
+   * @return  False if the used list has not been read yet.
+   */
+    bool tryNextUsedPage(const PageId page_number, PageId &next) const;
+
+    /**
+   * Writes the file header and forces the changes written to the file so far
+   * to stable storage with fdatasync(), unless the durability of the file is
+   * DURABILITY_NONE.
+   * 将已写入的修改同步到磁盘
+   * @throws  FileIOException  If the sync fails.
+   */
+    void sync() const;
+
+    /**
+   * Sets when the changes written to the file are forced to stable storage.
+   * The setting is shared by all File objects of the file and lasts until the
+   * file is closed by all of them.  Files start with DURABILITY_ON_SYNC.
+   *
+   * @param durability  New durability of the file.
+   */
+    void setDurability(const Durability durability);
+
+    /**
+   * Returns when the changes written to the file are forced to stable storage.
+   */
+    Durability durability() const;
+
     /**
    * Returns the name of the file this object represents.
    * 返回文件名
@@ -188,6 +343,15 @@ public:
    */
     const std::string &filename() const { return filename_; }
 
+    /**
+   * Returns the process-wide id of the file this object represents.  All File
+   * objects referring to the same file share one id, and the id stays the same
+   * when the file is closed and opened again until the file is removed.
+   * 返回文件的整数编号，同一文件的所有File对象编号相同
+   * @return Id of file.
+   */
+    FileId id() const { return id_; }
+
     /**
    * Returns an iterator at the first page in the file.
    * 返回文件的第一个页面
@@ -211,7 +375,7 @@ private:
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-    static std::streampos pagePosition(const PageId page_number)
+    static off_t pagePosition(const PageId page_number)
     {
         return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
     }
@@ -236,21 +400,24 @@ private:
     /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
-   * 如果之前没有被打开，则打开文件，否则重用现有的流
+   * the same filesystem file; otherwise, it reuses the existing descriptor.
+   * 如果之前没有被打开，则打开文件，否则重用现有的文件描述符
    *
    * @param create_new  Whether to create a new file.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  FileIOException         If the underlying file can not be opened.
+   * @throws  FileFormatException     If the underlying file's on-disk format
+   *                                  is not supported.
    */
     void openIfNeeded(const bool create_new);
 
     /**
-   * Closes the underlying file stream in <stream_>.
+   * Closes the underlying file descriptor in <state_>.
    * This method only closes the file if no other File objects exist that access
-   * the same file.
+   * the same file; the file header is written back then if it has changed.
    */
     void close();
 
@@ -258,8 +425,8 @@ private:
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file reads
+   * as a free page.
    * 读取一个页面
    *
    * @param page_number   Number of page to read.
@@ -270,6 +437,19 @@ private:
    */
     Page readPage(const PageId page_number, const bool allow_free) const;
 
+    /**
+   * Reads a page from the file into the given page with one read call.
+   * No bounds checking is performed; a page past the end of the file reads
+   * as a free page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page the contents are read into.
+   * @param allow_free    Whether to allow reading a free (unused) page.
+   * @throws  InvalidPageException  If the page is free (unused) and
+   *                                allow_free is false.
+   */
+    void readPageInto(const PageId page_number, Page &page, const bool allow_free) const;
+
     /**
    * Writes a page into the file at the given page number.  This does not
    * update ensure that the number in the header equals the position on disk.
@@ -293,19 +473,29 @@ private:
                    const Page &new_page);
 
     /**
-   * Reads the header for this file from disk.
-   * 从磁盘上读取文件头
+   * Returns the header for this file, kept in memory while the file is open.
+   * 返回缓存在内存中的文件头
    * @return  The file header.
    */
     FileHeader readHeader() const;
 
     /**
-   * Writes the given header to the disk as the header for this file.
-   * 向磁盘中写文件头
+   * Replaces the header for this file in memory.  It is written to disk by
+   * the next flushHeader().
+   * 修改内存中的文件头，写回磁盘被推迟
    * @param header  File header to write.
    */
     void writeHeader(const FileHeader &header);
 
+    /**
+   * Writes the header for this file to disk if it has changed since it was
+   * last written.  Called by sync(); the last File object of the file to be
+   * closed writes it as well.
+   * 如果文件头被修改过，将其写回磁盘
+   * @throws  FileIOException  If the write fails.
+   */
+    void flushHeader() const;
+
     /**
    * Reads only the header of the given page from disk (not the record data
    * or slot table).  No bounds checking is performed.
@@ -315,28 +505,179 @@ private:
    */
     PageHeader readPageHeader(const PageId page_number) const;
 
-    typedef std::map<std::string, std::shared_ptr<std::fstream>> StreamMap;
+    /**
+   * Points the page header of the given used page on disk to a new next page,
+   * leaving the rest of the page as it is.  Must be called with the latch of
+   * the file held.
+   *
+   * @param page_number   Number of page whose next page changes.
+   * @param next_page_number  Number of the new next page.
+   */
+    void setNextPageNumber(const PageId page_number, const PageId next_page_number);
+
+    /**
+   * Links a page that is becoming used into the used list, which is ordered
+   * by page number: sets its next page number, updates the page before it on
+   * disk and the first and last used page in header.  Must be called with the
+   * latch of the file held; the page itself is written by the caller.
+   *
+   * @param header  Header of the file, updated in place.
+   * @param page    Page that is becoming used.
+   */
+    void linkUsedPage(FileHeader &header, Page &page);
+
+    /**
+   * Returns the numbers of the used pages of the file.  They are read by
+   * walking the page headers of the used list the first time a page is
+   * deleted or inserted in the middle of the list; afterwards the set is kept
+   * up to date.  Must be called with the
+   * latch of the file held.
+   */
+    std::set<PageId> &usedPages() const;
+
+    /**
+   * Checks the format of the header just read when the file is opened and
+   * brings a version 0 file to FileHeader::VERSION.  A version 0 file is
+   * copied to a temporary file with the longer header, with last_used_page
+   * found by walking the used list; the copy is synced and renamed over the
+   * original, so a crash leaves either the old or the new file behind.  The
+   * file must not be in use by another process meanwhile.
+   *
+   * @throws  FileFormatException  If the file has no valid header of a
+   *                               version this code supports.
+   * @throws  FileIOException  If reading or writing the file fails.
+   */
+    void checkFormat();
+
+    /**
+   * Reads size bytes at the given offset of the file with pread(), retrying
+   * interrupted and partial reads.  Bytes past the end of the file read as 0.
+   *
+   * @param buffer  Memory the bytes are read into.
+   * @param size    Number of bytes to read.
+   * @param offset  Offset in the file to read from.
+   * @throws  FileIOException  If the read fails.
+   */
+    void readAt(void *buffer, const std::size_t size, const off_t offset) const;
+
+    /**
+   * Writes size bytes at the given offset of the file with pwrite(), retrying
+   * interrupted and partial writes.
+   *
+   * @param buffer  Memory the bytes are written from.
+   * @param size    Number of bytes to write.
+   * @param offset  Offset in the file to write to.
+   * @throws  FileIOException  If the write fails.
+   */
+    void writeAt(const void *buffer, const std::size_t size, const off_t offset) const;
+
+    /**
+   * Writes like writeAt(const void *, const std::size_t, const off_t) to
+   * another descriptor, for instance a file being built to replace this one.
+   */
+    void writeAt(const int fd, const void *buffer, const std::size_t size, const off_t offset) const;
+
+    /**
+   * Called at the end of every call that changes the file, syncs the file if
+   * its durability is DURABILITY_PER_WRITE.
+   */
+    void syncIfPerWrite() const;
+
+    /**
+   * @brief State of an opened file shared by all File objects of the file.
+   */
+    struct OpenFile
+    {
+        /**
+     * Descriptor of the underlying file, closed when the last File object of
+     * the file goes away.
+     */
+        int fd;
+
+        /**
+     * Latch serializing changes of the file header and of the page lists.
+     * Positional page reads and writes do not need it.
+     */
+        std::recursive_mutex latch;
+
+        /**
+     * When the changes written to the file are forced to stable storage.
+     */
+        std::atomic<int> durability;
+
+        /**
+     * Header of the file, read when the file is opened and written back
+     * lazily.  Guarded by latch.
+     */
+        FileHeader header;
+
+        /**
+     * Whether header has changed since it was last written to disk
+     */
+        bool header_dirty;
+
+        /**
+     * Numbers of the used pages, valid if used_pages_loaded is set.  Guarded
+     * by latch.
+     */
+        std::set<PageId> used_pages;
+
+        /**
+     * Whether used_pages has been read from the used list
+     */
+        bool used_pages_loaded;
+
+        explicit OpenFile(const int fd)
+            : fd(fd), durability(DURABILITY_ON_SYNC), header_dirty(false), used_pages_loaded(false) {}
+        ~OpenFile();
+    };
+
+    typedef std::map<std::string, std::shared_ptr<OpenFile>> OpenFileMap;
     typedef std::map<std::string, int> CountMap;
+    typedef std::map<std::string, FileId> IdMap;
+
+    /**
+   * Shared state of opened files.
+   */
+    static OpenFileMap open_files_;
 
     /**
-   * Streams for opened files.
+   * Latch of open_files_, open_counts_ and file_ids_, so files may be opened
+   * and closed in several threads.
    */
-    static StreamMap open_streams_;
+    static std::mutex open_files_latch_;
 
     /**
    * Counts for opened files.
    */
     static CountMap open_counts_;
 
+    /**
+   * Ids handed out to files, kept across close() so reopening a file yields
+   * the same id.  Entries are dropped when the file is removed.
+   */
+    static IdMap file_ids_;
+
+    /**
+   * Id handed to the next file that gets registered in file_ids_.
+   */
+    static FileId next_file_id_;
+
     /**
    * Name of the file this object represents.
    */
     std::string filename_;
 
     /**
-   * Stream for underlying filesystem object.
+   * Id of the file this object represents.
+   */
+    FileId id_;
+
+    /**
+   * Descriptor and latch of the underlying filesystem object, shared by all
+   * File objects of the file.
    */
-    std::shared_ptr<std::fstream> stream_;
+    std::shared_ptr<OpenFile> state_;
 
     friend class FileIterator;
     friend class FileTest;
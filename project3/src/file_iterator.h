@@ -92,13 +92,13 @@ public:
    */
     inline bool operator==(const FileIterator &rhs) const
     {
-        return file_->filename() == rhs.file_->filename() &&
+        return file_->id() == rhs.file_->id() &&
                current_page_number_ == rhs.current_page_number_;
     }
 
     inline bool operator!=(const FileIterator &rhs) const
     {
-        return (file_->filename() != rhs.file_->filename()) ||
+        return (file_->id() != rhs.file_->id()) ||
                (current_page_number_ != rhs.current_page_number_);
     }
 
@@ -65,6 +65,9 @@ void createDatabase(BufMgr *bufMgr, Catalog *catalog)
         HeapFileManager::insertTuple(tuple, rightTableFile, bufMgr);
     }
     // INSERT INTO s VALUES (i, 'sxxx');
+    // the base tables are forced to disk once, after the whole load
+    bufMgr->sync(&leftTableFile);
+    bufMgr->sync(&rightTableFile);
     // Print all tuples in tables
     TableScanner leftTableScanner(leftTableFile, leftTableSchema, bufMgr);
     leftTableScanner.print();
@@ -89,6 +92,8 @@ void testOnePassJoin(BufMgr *bufMgr, Catalog *catalog)
     string filename = leftTableSchema.getTableName() + "_OPJ_" +
                       rightTableSchema.getTableName() + ".tbl";
     File resultFile = File::create(filename);
+    // join results are temporary, they never need to reach stable storage
+    resultFile.setDurability(DURABILITY_NONE);
     joinOperator.execute(100, resultFile);
 
     // Print running statistics
@@ -117,6 +122,8 @@ void testNestedLoopJoin(BufMgr *bufMgr, Catalog *catalog)
     string filename = leftTableSchema.getTableName() + "_NLJ_" +
                       rightTableSchema.getTableName() + ".tbl";
     File resultFile = File::create(filename);
+    // join results are temporary, they never need to reach stable storage
+    resultFile.setDurability(DURABILITY_NONE);
     joinOperator.execute(10, resultFile);
 
     // Print running statistics
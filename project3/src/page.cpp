@@ -6,6 +6,7 @@
  */
 
 #include <cassert>
+#include <cstring>
 
 #include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_record_exception.h"
@@ -27,7 +28,7 @@ void Page::initialize()
 	header_.num_free_slots = 0;					  //剩余slots个数，初始化为0
 	header_.current_page_number = INVALID_NUMBER; //文件内页面的编号。初始化为无效的页面数0
 	header_.next_page_number = INVALID_NUMBER;	  //文件中下一个使用的页面的编号。初始化为无效的页面数0
-	data_.assign(DATA_SIZE, char());
+	std::memset(data_, 0, DATA_SIZE);
 }
 
 RecordId Page::insertRecord(const std::string &record_data)
@@ -46,7 +47,7 @@ std::string Page::getRecord(const RecordId &record_id) const
 {
 	validateRecordId(record_id); //确保记录ID可用
 	const PageSlot &slot = getSlot(record_id.slot_number);
-	return data_.substr(slot.item_offset, slot.item_length); //获取内容
+	return std::string(&data_[slot.item_offset], slot.item_length); //获取内容
 }
 
 void Page::updateRecord(const RecordId &record_id, const std::string &record_data)
@@ -75,7 +76,7 @@ void Page::deleteRecord(const RecordId &record_id, const bool allow_slot_compact
 {
 	validateRecordId(record_id);
 	PageSlot *slot = getSlot(record_id.slot_number);
-	data_.replace(slot->item_offset, slot->item_length, slot->item_length, '\0'); //使用'\0'替换所有的数据
+	std::memset(&data_[slot->item_offset], '\0', slot->item_length); //使用'\0'替换所有的数据
 
 	// Compact the data by removing the hole left by this record (if necessary).
 	std::uint16_t move_offset = slot->item_offset; //move_offset是需要移动的字节的最小值（自删除位置开始，向下最小的偏置的位置）
@@ -99,8 +100,7 @@ void Page::deleteRecord(const RecordId &record_id, const bool allow_slot_compact
 	// 如果需要移动，向右移动
 	if (move_bytes > 0)
 	{
-		const std::string &data_to_move = data_.substr(move_offset, move_bytes);
-		data_.replace(move_offset + slot->item_length, move_bytes, data_to_move);
+		std::memmove(&data_[move_offset + slot->item_length], &data_[move_offset], move_bytes);
 	}
 	header_.free_space_upper_bound += slot->item_length; //更新空闲空间的上限
 
@@ -213,7 +213,7 @@ void Page::insertRecordInSlot(const SlotId slot_number, const std::string &recor
 	slot->item_offset = header_.free_space_upper_bound - record_length; //使用upper_bound确定偏置的位置
 	header_.free_space_upper_bound = slot->item_offset;					//更新upper_bound的数值
 	--header_.num_free_slots;											//实际把数据储存到page上以后再减少可用slot数目
-	data_.replace(slot->item_offset, slot->item_length, record_data);	//更新数据
+	std::memcpy(&data_[slot->item_offset], record_data.data(), slot->item_length); //更新数据
 }
 
 void Page::validateRecordId(const RecordId &record_id) const
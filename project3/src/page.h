@@ -13,6 +13,7 @@
 #include <stdint.h>
 #include <memory>
 #include <string>
+#include <type_traits>
 
 namespace badgerdb
 {
@@ -117,6 +118,10 @@ class PageIterator;
  * slots and identified by a RecordId.  Although a record's actual contents may
  * be moved on the page, accessing a record by its slot is consistent.
  *
+ * A page is a plain block of exactly SIZE bytes laid out as on disk, so copying
+ * a page never allocates and a page can be read into or written from a buffer
+ * frame as is.
+ *
  * @warning This class is not threadsafe.
  */
 class Page
@@ -364,8 +369,7 @@ private:
    * well as actual content.
    * 储存在page上的数据，包括关于slot的记录信息，以及实际内容
    */
-
-    std::string data_;
+    char data_[DATA_SIZE];
 
     friend class File;
     friend class PageIterator;
@@ -377,5 +381,9 @@ static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
 static_assert(Page::DATA_SIZE > 0,
               "Page must have some space to hold data.");
+static_assert(sizeof(Page) == Page::SIZE,
+              "Page must have the same layout in memory as on disk.");
+static_assert(std::is_trivially_copyable<Page>::value,
+              "Pages must be copyable without allocating.");
 
 } // namespace badgerdb
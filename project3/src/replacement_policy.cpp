@@ -0,0 +1,681 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+// 缓冲池的页面替换策略：时钟、LRU-K、2Q和ARC
+#include <algorithm>
+#include "replacement_policy.h"
+#include "buffer.h"
+
+namespace badgerdb
+{
+
+ReplacementPolicy *ReplacementPolicy::create(const ReplacementPolicyType type, BufDesc *descs,
+                                             const FrameId firstFrame, const std::uint32_t numFrames,
+                                             const std::uint32_t lruK)
+{
+    switch (type)
+    {
+    case LRU_K_POLICY:
+        return new LruKPolicy(descs, firstFrame, numFrames, lruK);
+    case TWO_Q_POLICY:
+        return new TwoQPolicy(descs, firstFrame, numFrames);
+    case ARC_POLICY:
+        return new ArcPolicy(descs, firstFrame, numFrames);
+    case CLOCK_POLICY:
+    default:
+        return new ClockPolicy(descs, firstFrame, numFrames);
+    }
+}
+
+bool ReplacementPolicy::isPinned(const FrameId frame) const
+{
+    return descs[frame].pinCount() != 0 ||
+           descs[frame].testFlags(BufDesc::WRITE_IN_PROGRESS | BufDesc::READ_IN_PROGRESS);
+}
+
+bool ReplacementPolicy::getRefbit(const FrameId frame) const
+{
+    return descs[frame].testFlags(BufDesc::REFBIT);
+}
+
+void ReplacementPolicy::setRefbit(const FrameId frame, const bool refbit)
+{
+    if (refbit)
+        descs[frame].setFlags(BufDesc::REFBIT);
+    else
+        descs[frame].clearFlags(BufDesc::REFBIT);
+}
+
+bool ReplacementPolicy::isValid(const FrameId frame) const
+{
+    return descs[frame].testFlags(BufDesc::VALID);
+}
+
+bool ReplacementPolicy::isDirty(const FrameId frame) const
+{
+    return descs[frame].testFlags(BufDesc::DIRTY);
+}
+
+std::uint64_t ReplacementPolicy::pageKey(const FrameId frame) const
+{
+    return pageKey(descs[frame].fileId, descs[frame].pageNo);
+}
+
+bool ReplacementPolicy::pickCleanVictim(const std::uint32_t window, FrameId &frame, bool &skipped)
+{
+    std::vector<FrameId> candidates;
+    peekVictims(window, candidates);
+    // the first candidate is what pickVictim() would return anyway
+    for (std::size_t i = 0; i < candidates.size(); i++)
+    {
+        if (isDirty(candidates[i]))
+            continue;
+        frame = candidates[i];
+        recordEvict(frame);
+        skipped = i > 0;
+        return true;
+    }
+    return false;
+}
+
+void ReplacementPolicy::recordEvict(const FrameId frame)
+{
+    recordRemove(frame);
+}
+
+void ReplacementPolicy::resize(const std::uint32_t numFrames)
+{
+    this->numFrames = numFrames;
+}
+
+//----------------------------------------------------------------------------
+// Clock
+
+ClockPolicy::ClockPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames)
+    : ReplacementPolicy(descs, firstFrame, numFrames),
+      clockHand(firstFrame + numFrames - 1)
+{
+}
+
+void ClockPolicy::advanceClock()
+{
+    clockHand++;
+    if (clockHand == firstFrame + numFrames)
+        clockHand = firstFrame;
+}
+
+void ClockPolicy::recordHit(const FrameId frame)
+{
+    setRefbit(frame, true);
+}
+
+void ClockPolicy::recordLoad(const FrameId frame)
+{
+    // BufDesc::Set() already gave the page its reference bit
+}
+
+void ClockPolicy::recordRemove(const FrameId frame)
+{
+    // nothing to forget, the sweep only looks at the frame descriptors
+}
+
+bool ClockPolicy::pickVictim(const FileId fileId, const PageId pageNo, FrameId &frame)
+{
+    // The first pass clears every reference bit it passes, so an unpinned frame
+    // is always found within two passes if one exists.
+    for (std::uint32_t i = 0; i < 2 * numFrames; i++)
+    {
+        advanceClock();
+        if (getRefbit(clockHand) == false)
+        {
+            if (!isPinned(clockHand))
+            {
+                frame = clockHand;
+                return true;
+            }
+        }
+        else
+            setRefbit(clockHand, false);
+    }
+    return false;
+}
+
+void ClockPolicy::peekVictims(const std::uint32_t max, std::vector<FrameId> &frames) const
+{
+    // frames the hand reaches with the reference bit already cleared go first,
+    // the others only after the hand has cleared their bit on its first pass
+    const std::size_t start = frames.size();
+    for (int pass = 0; pass < 2; pass++)
+    {
+        FrameId hand = clockHand;
+        for (std::uint32_t i = 0; i < numFrames && frames.size() - start < max; i++)
+        {
+            hand = hand + 1 == firstFrame + numFrames ? firstFrame : hand + 1;
+            if (isPinned(hand) || getRefbit(hand) != (pass == 1))
+                continue;
+            frames.push_back(hand);
+        }
+    }
+}
+
+bool ClockPolicy::pickCleanVictim(const std::uint32_t window, FrameId &frame, bool &skipped)
+{
+    // Only frames the sweep would evict as it reaches them, i.e. with the
+    // reference bit already clear, are taken; a recently used clean page is
+    // not worth more than a cold dirty one.
+    FrameId hand = clockHand;
+    std::uint32_t seen = 0;
+    bool passedDirty = false;
+    for (std::uint32_t i = 0; i < numFrames && seen < window; i++)
+    {
+        hand = hand + 1 == firstFrame + numFrames ? firstFrame : hand + 1;
+        // free frames are visited too when called by BufMgr::reserveVictims()
+        if (isPinned(hand) || !isValid(hand))
+            continue;
+        seen++;
+        if (getRefbit(hand))
+            continue;
+        if (isDirty(hand))
+        {
+            passedDirty = true;
+            continue;
+        }
+        // move the hand there the way pickVictim() would, clearing the
+        // reference bits it passes
+        for (advanceClock(); clockHand != hand; advanceClock())
+            setRefbit(clockHand, false);
+        frame = hand;
+        skipped = passedDirty;
+        return true;
+    }
+    return false;
+}
+
+void ClockPolicy::resize(const std::uint32_t numFrames)
+{
+    ReplacementPolicy::resize(numFrames);
+    if (clockHand >= firstFrame + numFrames)
+        clockHand = firstFrame + numFrames - 1;
+}
+
+//----------------------------------------------------------------------------
+// LRU-K
+
+LruKPolicy::LruKPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames,
+                       const std::uint32_t k)
+    : ReplacementPolicy(descs, firstFrame, numFrames),
+      k(std::max(k, (std::uint32_t)1)),
+      now(0),
+      history((std::size_t)numFrames * this->k),
+      historyLen(numFrames, 0),
+      tracked(numFrames, false)
+{
+}
+
+std::uint64_t LruKPolicy::priority(const FrameId frame) const
+{
+    const std::uint32_t i = frame - firstFrame;
+    // fewer than k accesses: infinite backward distance, least recently used first
+    if (historyLen[i] < k)
+        return history[(std::size_t)i * k];
+    return (1ULL << 63) + history[(std::size_t)i * k + k - 1];
+}
+
+void LruKPolicy::untrack(const FrameId frame)
+{
+    const std::uint32_t i = frame - firstFrame;
+    if (!tracked[i])
+        return;
+    order.erase(Entry(priority(frame), frame));
+    tracked[i] = false;
+}
+
+void LruKPolicy::access(const FrameId frame)
+{
+    const std::uint32_t i = frame - firstFrame;
+    untrack(frame);
+    std::uint64_t *h = &history[(std::size_t)i * k];
+    for (std::uint32_t j = k - 1; j > 0; j--)
+        h[j] = h[j - 1];
+    h[0] = ++now;
+    if (historyLen[i] < k)
+        historyLen[i]++;
+    order.insert(Entry(priority(frame), frame));
+    tracked[i] = true;
+}
+
+void LruKPolicy::recordHit(const FrameId frame)
+{
+    access(frame);
+}
+
+void LruKPolicy::recordLoad(const FrameId frame)
+{
+    const std::uint32_t i = frame - firstFrame;
+    historyLen[i] = 0;
+    std::unordered_map<std::uint64_t, Retained>::iterator it = retained.find(pageKey(frame));
+    if (it != retained.end())
+    {
+        const std::vector<std::uint64_t> &old = it->second.first;
+        std::copy(old.begin(), old.end(), history.begin() + (std::size_t)i * k);
+        historyLen[i] = old.size();
+        retainedOrder.erase(it->second.second);
+        retained.erase(it);
+    }
+    access(frame);
+}
+
+void LruKPolicy::recordRemove(const FrameId frame)
+{
+    untrack(frame);
+    historyLen[frame - firstFrame] = 0;
+}
+
+bool LruKPolicy::pickVictim(const FileId fileId, const PageId pageNo, FrameId &frame)
+{
+    for (std::set<Entry>::iterator it = order.begin(); it != order.end(); ++it)
+    {
+        if (isPinned(it->second))
+            continue;
+        frame = it->second;
+        retain(frame);
+        return true;
+    }
+    return false;
+}
+
+void LruKPolicy::recordEvict(const FrameId frame)
+{
+    retain(frame);
+}
+
+void LruKPolicy::retain(const FrameId frame)
+{
+    const std::uint32_t i = frame - firstFrame;
+    // remember the history of the evicted page for a while
+    const std::uint64_t key = pageKey(frame);
+    std::vector<std::uint64_t> old(history.begin() + (std::size_t)i * k,
+                                   history.begin() + (std::size_t)i * k + historyLen[i]);
+    retainedOrder.push_back(key);
+    retained[key] = Retained(old, --retainedOrder.end());
+    if (retained.size() > numFrames)
+    {
+        retained.erase(retainedOrder.front());
+        retainedOrder.pop_front();
+    }
+
+    untrack(frame);
+    historyLen[i] = 0;
+}
+
+void LruKPolicy::peekVictims(const std::uint32_t max, std::vector<FrameId> &frames) const
+{
+    const std::size_t start = frames.size();
+    for (std::set<Entry>::const_iterator it = order.begin();
+         it != order.end() && frames.size() - start < max; ++it)
+    {
+        if (!isPinned(it->second))
+            frames.push_back(it->second);
+    }
+}
+
+void LruKPolicy::resize(const std::uint32_t numFrames)
+{
+    ReplacementPolicy::resize(numFrames);
+    history.resize((std::size_t)numFrames * k);
+    historyLen.resize(numFrames, 0);
+    tracked.resize(numFrames, false);
+    while (retained.size() > numFrames)
+    {
+        retained.erase(retainedOrder.front());
+        retainedOrder.pop_front();
+    }
+}
+
+//----------------------------------------------------------------------------
+// 2Q
+
+TwoQPolicy::TwoQPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames)
+    : ReplacementPolicy(descs, firstFrame, numFrames),
+      kin(std::max(numFrames / 4, (std::uint32_t)1)),
+      kout(std::max(numFrames / 2, (std::uint32_t)1)),
+      queueOf(numFrames, NONE),
+      position(numFrames)
+{
+}
+
+void TwoQPolicy::unlink(const FrameId frame)
+{
+    const std::uint32_t i = frame - firstFrame;
+    if (queueOf[i] == A1IN)
+        a1in.erase(position[i]);
+    else if (queueOf[i] == AM)
+        am.erase(position[i]);
+    queueOf[i] = NONE;
+}
+
+bool TwoQPolicy::evictFrom(std::list<FrameId> &queue, FrameId &frame)
+{
+    for (std::list<FrameId>::reverse_iterator it = queue.rbegin(); it != queue.rend(); ++it)
+    {
+        if (!isPinned(*it))
+        {
+            frame = *it;
+            unlink(frame);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TwoQPolicy::recordHit(const FrameId frame)
+{
+    const std::uint32_t i = frame - firstFrame;
+    // hits in A1in are ignored on purpose: correlated references of a page
+    // read once must not promote it
+    if (queueOf[i] == AM)
+        am.splice(am.begin(), am, position[i]);
+}
+
+void TwoQPolicy::recordLoad(const FrameId frame)
+{
+    const std::uint32_t i = frame - firstFrame;
+    const std::uint64_t key = pageKey(frame);
+    std::unordered_map<std::uint64_t, std::list<std::uint64_t>::iterator>::iterator it = a1outIndex.find(key);
+    if (it != a1outIndex.end())
+    {
+        a1out.erase(it->second);
+        a1outIndex.erase(it);
+        am.push_front(frame);
+        position[i] = am.begin();
+        queueOf[i] = AM;
+    }
+    else
+    {
+        a1in.push_front(frame);
+        position[i] = a1in.begin();
+        queueOf[i] = A1IN;
+    }
+}
+
+void TwoQPolicy::recordRemove(const FrameId frame)
+{
+    unlink(frame);
+}
+
+void TwoQPolicy::rememberEvicted(const FrameId frame)
+{
+    const std::uint64_t key = pageKey(frame);
+    a1out.push_front(key);
+    a1outIndex[key] = a1out.begin();
+    if (a1out.size() > kout)
+    {
+        a1outIndex.erase(a1out.back());
+        a1out.pop_back();
+    }
+}
+
+bool TwoQPolicy::pickVictim(const FileId fileId, const PageId pageNo, FrameId &frame)
+{
+    // A1in gives up pages while it is above its target size, Am otherwise
+    if (a1in.size() > kin && evictFrom(a1in, frame))
+    {
+        rememberEvicted(frame);
+        return true;
+    }
+    if (evictFrom(am, frame))
+        return true;
+    if (evictFrom(a1in, frame))
+    {
+        rememberEvicted(frame);
+        return true;
+    }
+    return false;
+}
+
+void TwoQPolicy::recordEvict(const FrameId frame)
+{
+    const bool fromA1in = queueOf[frame - firstFrame] == A1IN;
+    unlink(frame);
+    if (fromA1in)
+        rememberEvicted(frame);
+}
+
+void TwoQPolicy::peekQueue(const std::list<FrameId> &queue, const std::uint32_t max,
+                           std::vector<FrameId> &frames) const
+{
+    for (std::list<FrameId>::const_reverse_iterator it = queue.rbegin();
+         it != queue.rend() && frames.size() < max; ++it)
+    {
+        if (!isPinned(*it))
+            frames.push_back(*it);
+    }
+}
+
+void TwoQPolicy::peekVictims(const std::uint32_t max, std::vector<FrameId> &frames) const
+{
+    const std::uint32_t limit = frames.size() + max;
+    if (a1in.size() > kin)
+    {
+        peekQueue(a1in, limit, frames);
+        peekQueue(am, limit, frames);
+    }
+    else
+    {
+        peekQueue(am, limit, frames);
+        peekQueue(a1in, limit, frames);
+    }
+}
+
+void TwoQPolicy::resize(const std::uint32_t numFrames)
+{
+    ReplacementPolicy::resize(numFrames);
+    kin = std::max(numFrames / 4, (std::uint32_t)1);
+    kout = std::max(numFrames / 2, (std::uint32_t)1);
+    queueOf.resize(numFrames, NONE);
+    position.resize(numFrames);
+    while (a1out.size() > kout)
+    {
+        a1outIndex.erase(a1out.back());
+        a1out.pop_back();
+    }
+}
+
+//----------------------------------------------------------------------------
+// ARC
+
+ArcPolicy::ArcPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames)
+    : ReplacementPolicy(descs, firstFrame, numFrames),
+      p(0),
+      listOf(numFrames, NONE),
+      position(numFrames)
+{
+}
+
+void ArcPolicy::unlink(const FrameId frame)
+{
+    const std::uint32_t i = frame - firstFrame;
+    if (listOf[i] == T1)
+        t1.erase(position[i]);
+    else if (listOf[i] == T2)
+        t2.erase(position[i]);
+    listOf[i] = NONE;
+}
+
+void ArcPolicy::ghostPush(GhostList &ghost, GhostIndex &index, const std::uint64_t key)
+{
+    ghost.push_front(key);
+    index[key] = ghost.begin();
+}
+
+void ArcPolicy::ghostDropLru(GhostList &ghost, GhostIndex &index)
+{
+    if (ghost.empty())
+        return;
+    index.erase(ghost.back());
+    ghost.pop_back();
+}
+
+void ArcPolicy::toGhost(const FrameId frame)
+{
+    const List list = listOf[frame - firstFrame];
+    if (list == T1)
+        ghostPush(b1, b1Index, pageKey(frame));
+    else if (list == T2)
+        ghostPush(b2, b2Index, pageKey(frame));
+    unlink(frame);
+}
+
+bool ArcPolicy::evictFrom(std::list<FrameId> &list, FrameId &frame)
+{
+    for (std::list<FrameId>::reverse_iterator it = list.rbegin(); it != list.rend(); ++it)
+    {
+        if (!isPinned(*it))
+        {
+            frame = *it;
+            toGhost(frame);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::uint32_t ArcPolicy::adaptedP(const std::uint64_t key, bool &inB2) const
+{
+    inB2 = false;
+    if (b1Index.count(key))
+    {
+        // recency was undervalued: grow T1
+        std::uint32_t delta = std::max((std::uint32_t)(b2.size() / b1.size()), (std::uint32_t)1);
+        return std::min(numFrames, p + delta);
+    }
+    if (b2Index.count(key))
+    {
+        // frequency was undervalued: shrink T1
+        std::uint32_t delta = std::max((std::uint32_t)(b1.size() / b2.size()), (std::uint32_t)1);
+        inB2 = true;
+        return p > delta ? p - delta : 0;
+    }
+    return p;
+}
+
+ArcPolicy::List ArcPolicy::classify(const std::uint64_t key)
+{
+    bool inB2;
+    p = adaptedP(key, inB2);
+    GhostIndex::iterator it = b1Index.find(key);
+    if (it != b1Index.end())
+    {
+        b1.erase(it->second);
+        b1Index.erase(it);
+        return T2;
+    }
+    it = b2Index.find(key);
+    if (it != b2Index.end())
+    {
+        b2.erase(it->second);
+        b2Index.erase(it);
+        return T2;
+    }
+    // brand new page: make room in the directory
+    if (t1.size() + b1.size() >= numFrames)
+        ghostDropLru(b1, b1Index);
+    else if (t1.size() + t2.size() + b1.size() + b2.size() >= 2 * numFrames)
+        ghostDropLru(b2, b2Index);
+    return T1;
+}
+
+void ArcPolicy::trimGhosts()
+{
+    while (t1.size() + b1.size() > numFrames && !b1.empty())
+        ghostDropLru(b1, b1Index);
+    while (t1.size() + t2.size() + b1.size() + b2.size() > 2 * numFrames && !b2.empty())
+        ghostDropLru(b2, b2Index);
+}
+
+void ArcPolicy::recordHit(const FrameId frame)
+{
+    const std::uint32_t i = frame - firstFrame;
+    if (listOf[i] == NONE)
+        return;
+    unlink(frame);
+    t2.push_front(frame);
+    position[i] = t2.begin();
+    listOf[i] = T2;
+}
+
+void ArcPolicy::recordLoad(const FrameId frame)
+{
+    const std::uint32_t i = frame - firstFrame;
+    // the ghosts are only consulted once the page is actually loaded, whatever
+    // way its frame was found
+    const List target = classify(pageKey(frame));
+    std::list<FrameId> &list = target == T1 ? t1 : t2;
+    list.push_front(frame);
+    position[i] = list.begin();
+    listOf[i] = target;
+    trimGhosts();
+}
+
+void ArcPolicy::recordRemove(const FrameId frame)
+{
+    unlink(frame);
+}
+
+bool ArcPolicy::pickVictim(const FileId fileId, const PageId pageNo, FrameId &frame)
+{
+    // REPLACE(x, p) of the ARC paper with p as it will be once recordLoad()
+    // adapts it, falling back to the other list when every frame of the
+    // preferred one is pinned
+    bool inB2;
+    const std::uint32_t target = adaptedP(pageKey(fileId, pageNo), inB2);
+    bool fromT1 = !t1.empty() && (t1.size() > target || (inB2 && t1.size() == target));
+    if (fromT1)
+        return evictFrom(t1, frame) || evictFrom(t2, frame);
+    return evictFrom(t2, frame) || evictFrom(t1, frame);
+}
+
+void ArcPolicy::recordEvict(const FrameId frame)
+{
+    toGhost(frame);
+}
+
+void ArcPolicy::peekList(const std::list<FrameId> &list, const std::uint32_t max,
+                         std::vector<FrameId> &frames) const
+{
+    for (std::list<FrameId>::const_reverse_iterator it = list.rbegin();
+         it != list.rend() && frames.size() < max; ++it)
+    {
+        if (!isPinned(*it))
+            frames.push_back(*it);
+    }
+}
+
+void ArcPolicy::peekVictims(const std::uint32_t max, std::vector<FrameId> &frames) const
+{
+    const std::uint32_t limit = frames.size() + max;
+    if (t1.size() > p)
+    {
+        peekList(t1, limit, frames);
+        peekList(t2, limit, frames);
+    }
+    else
+    {
+        peekList(t2, limit, frames);
+        peekList(t1, limit, frames);
+    }
+}
+
+void ArcPolicy::resize(const std::uint32_t numFrames)
+{
+    ReplacementPolicy::resize(numFrames);
+    listOf.resize(numFrames, NONE);
+    position.resize(numFrames);
+    p = std::min(p, numFrames);
+    trimGhosts();
+}
+
+} // namespace badgerdb
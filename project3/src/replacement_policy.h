@@ -0,0 +1,556 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+namespace badgerdb
+{
+
+class BufDesc;
+
+/**
+ * @brief Replacement policies shipped with the buffer manager.
+ */
+enum ReplacementPolicyType
+{
+    CLOCK_POLICY,
+    LRU_K_POLICY,
+    TWO_Q_POLICY,
+    ARC_POLICY
+};
+
+/**
+ * @brief Interface of the algorithm that decides which frame of a shard is evicted.
+ *
+ * BufMgr owns one policy object per shard and calls it with the shard latch
+ * held, so implementations need no synchronization of their own.  A policy
+ * only sees the frames [firstFrame, firstFrame + numFrames) of its shard and
+ * reads their state through the protected helpers; the buffer manager does the
+ * actual write back, page table update and descriptor reset of the victim.
+ *
+ * @warning This class is not threadsafe.
+ */
+class ReplacementPolicy
+{
+public:
+    /**
+   * Creates a policy of the given type for one shard.
+   *
+   * @param type        Policy to create.
+   * @param descs       Descriptor table of the whole buffer pool.
+   * @param firstFrame  First frame of the shard.
+   * @param numFrames   Number of frames of the shard.
+   * @param lruK        K used by LRU_K_POLICY, ignored otherwise.
+   * @return  Newly allocated policy, owned by the caller.
+   */
+    static ReplacementPolicy *create(const ReplacementPolicyType type, BufDesc *descs,
+                                     const FrameId firstFrame, const std::uint32_t numFrames,
+                                     const std::uint32_t lruK);
+
+    /**
+   * Constructor of ReplacementPolicy class
+   */
+    ReplacementPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames)
+        : descs(descs), firstFrame(firstFrame), numFrames(numFrames)
+    {
+    }
+
+    /**
+   * Destructor of ReplacementPolicy class
+   */
+    virtual ~ReplacementPolicy() {}
+
+    /**
+   * Returns the name of the policy, used in statistics.
+   */
+    virtual const char *name() const = 0;
+
+    /**
+   * Called when a page already present in the frame is requested again.
+   *
+   * @param frame   Frame that was hit.
+   */
+    virtual void recordHit(const FrameId frame) = 0;
+
+    /**
+   * Called after a frame has been filled with a new page.  The frame
+   * descriptor is valid and holds the page when this is called.
+   *
+   * @param frame   Frame that was loaded.
+   */
+    virtual void recordLoad(const FrameId frame) = 0;
+
+    /**
+   * Called after a frame has been emptied without being chosen as a victim,
+   * e.g. by flushFile() or disposePage(), or when loading it failed.  The frame
+   * goes to the free list of the buffer manager.  Must tolerate frames the
+   * policy does not track.
+   *
+   * @param frame   Frame that is now free.
+   */
+    virtual void recordRemove(const FrameId frame) = 0;
+
+    /**
+   * Chooses an unpinned frame to hold the given page.  Only called when the
+   * buffer manager has no free frame left, so every frame of the shard holds a
+   * valid page; the caller evicts the page of the returned frame.  The policy
+   * stops tracking the returned frame until recordLoad() or recordRemove() is
+   * called for it.
+   *
+   * @param fileId  File of the page that is going to be loaded.
+   * @param pageNo  Number of the page that is going to be loaded.
+   * @param frame   Frame reference, frame ID of the victim returned via this variable.
+   * @return  False if every frame of the shard is pinned.
+   */
+    virtual bool pickVictim(const FileId fileId, const PageId pageNo, FrameId &frame) = 0;
+
+    /**
+   * Stops tracking an unpinned frame the buffer manager evicts as a victim
+   * of its own choosing, e.g. one of peekVictims(), keeping the same history
+   * of the evicted page as pickVictim() would.  Called while the frame still
+   * holds the page.  The default forgets the frame like recordRemove().
+   *
+   * @param frame   Frame that is going to be evicted.
+   */
+    virtual void recordEvict(const FrameId frame);
+
+    /**
+   * Lists the unpinned frames the policy is going to evict next, most imminent
+   * first, without changing any state.  Used by the background writer to clean
+   * frames before a foreground miss reaches them.
+   *
+   * @param max     Maximum number of frames to return.
+   * @param frames  Candidate frames are appended to this vector.
+   */
+    virtual void peekVictims(const std::uint32_t max, std::vector<FrameId> &frames) const = 0;
+
+    /**
+   * Chooses an unpinned clean frame among the next victims of the policy, for
+   * BufMgrOptions::cleanFirstWindow.  Like pickVictim() the policy stops
+   * tracking the returned frame.  The default takes the first clean frame
+   * peekVictims() lists through recordEvict(); policies whose list goes beyond the frames they are
+   * ready to evict override it.  Frames without a valid page are never returned.
+   *
+   * @param window  Number of upcoming victims to search.
+   * @param frame   Frame reference, frame ID of the clean victim returned via this variable.
+   * @param skipped Set to true if dirty victims ahead of it were passed over.
+   * @return  False if none of the upcoming victims is clean; nothing changes then.
+   */
+    virtual bool pickCleanVictim(const std::uint32_t window, FrameId &frame, bool &skipped);
+
+    /**
+   * Called when the shard grows or shrinks at its tail.  When shrinking, the
+   * buffer manager has already emptied the frames beyond the new size and
+   * called recordRemove() for each of them.  New frames are free.
+   *
+   * @param numFrames   New number of frames of the shard.
+   */
+    virtual void resize(const std::uint32_t numFrames);
+
+protected:
+    /**
+   * Descriptor table of the whole buffer pool
+   */
+    BufDesc *descs;
+
+    /**
+   * First frame of the shard
+   */
+    const FrameId firstFrame;
+
+    /**
+   * Number of frames of the shard
+   */
+    std::uint32_t numFrames;
+
+    /**
+   * Returns true if the frame can not be evicted right now because it is
+   * pinned or its page is being written by the background writer
+   */
+    bool isPinned(const FrameId frame) const;
+
+    /**
+   * Returns the reference bit of the frame
+   */
+    bool getRefbit(const FrameId frame) const;
+
+    /**
+   * Returns true if the frame holds a page
+   */
+    bool isValid(const FrameId frame) const;
+
+    /**
+   * Returns true if the page held by the frame has to be written back before eviction
+   */
+    bool isDirty(const FrameId frame) const;
+
+    /**
+   * Sets the reference bit of the frame
+   */
+    void setRefbit(const FrameId frame, const bool refbit);
+
+    /**
+   * Returns the (file, page) key of the page held by the frame
+   */
+    std::uint64_t pageKey(const FrameId frame) const;
+
+    /**
+   * Packs a file id and page number into one key
+   */
+    static std::uint64_t pageKey(const FileId fileId, const PageId pageNo)
+    {
+        return ((std::uint64_t)fileId << 32) | pageNo;
+    }
+};
+
+/**
+ * @brief Clock (second chance) replacement, the classic BadgerDB behavior.
+ */
+class ClockPolicy : public ReplacementPolicy
+{
+public:
+    /**
+   * Constructor of ClockPolicy class
+   */
+    ClockPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames);
+
+    const char *name() const { return "CLOCK"; }
+    void recordHit(const FrameId frame);
+    void recordLoad(const FrameId frame);
+    void recordRemove(const FrameId frame);
+    bool pickVictim(const FileId fileId, const PageId pageNo, FrameId &frame);
+    void peekVictims(const std::uint32_t max, std::vector<FrameId> &frames) const;
+    bool pickCleanVictim(const std::uint32_t window, FrameId &frame, bool &skipped);
+    void resize(const std::uint32_t numFrames);
+
+private:
+    /**
+   * Current position of the clock hand
+   * 时钟算法的时针
+   */
+    FrameId clockHand;
+
+    /**
+   * Advance clock to next frame of the shard
+   */
+    void advanceClock();
+};
+
+/**
+ * @brief LRU-K: evicts the page whose K-th most recent access is the oldest.
+ *
+ * Pages with fewer than K recorded accesses count as infinitely old and are
+ * evicted first, least recently used among them first.  The access history of
+ * evicted pages is retained for up to numFrames pages so that a page which
+ * comes back quickly keeps its history.
+ */
+class LruKPolicy : public ReplacementPolicy
+{
+public:
+    /**
+   * Constructor of LruKPolicy class
+   *
+   * @param k   Number of most recent accesses remembered per page
+   */
+    LruKPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames,
+               const std::uint32_t k);
+
+    const char *name() const { return "LRU-K"; }
+    void recordHit(const FrameId frame);
+    void recordLoad(const FrameId frame);
+    void recordRemove(const FrameId frame);
+    bool pickVictim(const FileId fileId, const PageId pageNo, FrameId &frame);
+    void recordEvict(const FrameId frame);
+    void peekVictims(const std::uint32_t max, std::vector<FrameId> &frames) const;
+    void resize(const std::uint32_t numFrames);
+
+private:
+    typedef std::pair<std::uint64_t, FrameId> Entry;
+
+    /**
+   * Number of accesses remembered per page
+   */
+    const std::uint32_t k;
+
+    /**
+   * Logical time, advanced on every access
+   */
+    std::uint64_t now;
+
+    /**
+   * Access times per frame, most recent first, k entries per frame
+   */
+    std::vector<std::uint64_t> history;
+
+    /**
+   * Number of valid entries in history per frame
+   */
+    std::vector<std::uint32_t> historyLen;
+
+    /**
+   * Tracked frames ordered by eviction priority, first evicted first
+   */
+    std::set<Entry> order;
+
+    /**
+   * Whether each frame is tracked in order
+   */
+    std::vector<bool> tracked;
+
+    typedef std::list<std::uint64_t> RetainedOrder;
+    typedef std::pair<std::vector<std::uint64_t>, RetainedOrder::iterator> Retained;
+
+    /**
+   * Access histories of recently evicted pages
+   */
+    std::unordered_map<std::uint64_t, Retained> retained;
+
+    /**
+   * Keys of retained in insertion order, used to bound its size
+   */
+    RetainedOrder retainedOrder;
+
+    /**
+   * Eviction priority of a frame, lower is evicted first
+   */
+    std::uint64_t priority(const FrameId frame) const;
+
+    /**
+   * Records an access to the frame at the current time
+   */
+    void access(const FrameId frame);
+
+    /**
+   * Stops tracking the frame in order
+   */
+    void untrack(const FrameId frame);
+
+    /**
+   * Stops tracking the frame of an evicted page, keeping its history in retained
+   */
+    void retain(const FrameId frame);
+};
+
+/**
+ * @brief Full 2Q: new pages enter a FIFO and only pages re-referenced after
+ *        leaving it are promoted to the LRU main queue.
+ *
+ * A one-time scan therefore only cycles through the FIFO (A1in, a quarter of
+ * the frames) and leaves the hot pages in the main queue (Am) alone.  A1out
+ * remembers the pages recently evicted from A1in, up to half the frames.
+ */
+class TwoQPolicy : public ReplacementPolicy
+{
+public:
+    /**
+   * Constructor of TwoQPolicy class
+   */
+    TwoQPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames);
+
+    const char *name() const { return "2Q"; }
+    void recordHit(const FrameId frame);
+    void recordLoad(const FrameId frame);
+    void recordRemove(const FrameId frame);
+    bool pickVictim(const FileId fileId, const PageId pageNo, FrameId &frame);
+    void recordEvict(const FrameId frame);
+    void peekVictims(const std::uint32_t max, std::vector<FrameId> &frames) const;
+    void resize(const std::uint32_t numFrames);
+
+private:
+    enum Queue
+    {
+        NONE,
+        A1IN,
+        AM
+    };
+
+    /**
+   * Target size of A1in
+   */
+    std::uint32_t kin;
+
+    /**
+   * Maximum size of A1out
+   */
+    std::uint32_t kout;
+
+    /**
+   * Resident FIFO of pages seen once, newest first
+   */
+    std::list<FrameId> a1in;
+
+    /**
+   * Resident LRU of hot pages, most recently used first
+   */
+    std::list<FrameId> am;
+
+    /**
+   * Ghost FIFO of pages evicted from A1in, newest first
+   */
+    std::list<std::uint64_t> a1out;
+
+    /**
+   * Index of a1out
+   */
+    std::unordered_map<std::uint64_t, std::list<std::uint64_t>::iterator> a1outIndex;
+
+    /**
+   * Queue each frame is in
+   */
+    std::vector<Queue> queueOf;
+
+    /**
+   * Position of each frame in its queue
+   */
+    std::vector<std::list<FrameId>::iterator> position;
+
+    /**
+   * Removes the frame from the queue it is in
+   */
+    void unlink(const FrameId frame);
+
+    /**
+   * Takes the oldest unpinned frame out of the queue, returns false if all are pinned
+   */
+    bool evictFrom(std::list<FrameId> &queue, FrameId &frame);
+
+    /**
+   * Adds the page held by a frame evicted from A1in to A1out
+   */
+    void rememberEvicted(const FrameId frame);
+
+    /**
+   * Appends unpinned frames of the queue, oldest first, until frames holds max entries
+   */
+    void peekQueue(const std::list<FrameId> &queue, const std::uint32_t max,
+                   std::vector<FrameId> &frames) const;
+};
+
+/**
+ * @brief Adaptive Replacement Cache.
+ *
+ * Balances a recency list (T1) against a frequency list (T2) and adapts the
+ * target size p of T1 using the ghost lists B1 and B2 of recently evicted pages.
+ */
+class ArcPolicy : public ReplacementPolicy
+{
+public:
+    /**
+   * Constructor of ArcPolicy class
+   */
+    ArcPolicy(BufDesc *descs, const FrameId firstFrame, const std::uint32_t numFrames);
+
+    const char *name() const { return "ARC"; }
+    void recordHit(const FrameId frame);
+    void recordLoad(const FrameId frame);
+    void recordRemove(const FrameId frame);
+    bool pickVictim(const FileId fileId, const PageId pageNo, FrameId &frame);
+    void recordEvict(const FrameId frame);
+    void peekVictims(const std::uint32_t max, std::vector<FrameId> &frames) const;
+    void resize(const std::uint32_t numFrames);
+
+private:
+    enum List
+    {
+        NONE,
+        T1,
+        T2
+    };
+
+    typedef std::list<std::uint64_t> GhostList;
+    typedef std::unordered_map<std::uint64_t, GhostList::iterator> GhostIndex;
+
+    /**
+   * Target size of T1
+   */
+    std::uint32_t p;
+
+    /**
+   * Resident lists, most recently used first
+   */
+    std::list<FrameId> t1, t2;
+
+    /**
+   * Ghost lists, most recently evicted first
+   */
+    GhostList b1, b2;
+
+    /**
+   * Indexes of the ghost lists
+   */
+    GhostIndex b1Index, b2Index;
+
+    /**
+   * List each frame is in
+   */
+    std::vector<List> listOf;
+
+    /**
+   * Position of each frame in its list
+   */
+    std::vector<std::list<FrameId>::iterator> position;
+
+    /**
+   * Target size of T1 after a miss on the page, without changing anything
+   *
+   * @param key   Page that missed
+   * @param inB2  Set to true if the page is in B2
+   */
+    std::uint32_t adaptedP(const std::uint64_t key, bool &inB2) const;
+
+    /**
+   * Adapts p for a miss on the page, forgets its ghost and returns the list it goes into
+   */
+    List classify(const std::uint64_t key);
+
+    /**
+   * Drops ghosts until |T1| + |B1| <= c and the whole directory <= 2c
+   */
+    void trimGhosts();
+
+    /**
+   * Removes the frame from the list it is in
+   */
+    void unlink(const FrameId frame);
+
+    /**
+   * Moves the page of the frame from T1 or T2 to the matching ghost list
+   */
+    void toGhost(const FrameId frame);
+
+    /**
+   * Moves the least recently used unpinned page of the list to the ghost list
+   * and returns its frame, returns false if all are pinned
+   */
+    bool evictFrom(std::list<FrameId> &list, FrameId &frame);
+
+    /**
+   * Adds a key as most recently evicted page of the ghost list
+   */
+    void ghostPush(GhostList &ghost, GhostIndex &index, const std::uint64_t key);
+
+    /**
+   * Forgets the least recently evicted page of the ghost list
+   */
+    void ghostDropLru(GhostList &ghost, GhostIndex &index);
+
+    /**
+   * Appends unpinned frames of the list, least recently used first, until frames holds max entries
+   */
+    void peekList(const std::list<FrameId> &list, const std::uint32_t max,
+                  std::vector<FrameId> &frames) const;
+};
+
+} // namespace badgerdb
@@ -14,7 +14,6 @@
 #include <stdlib.h>
 #include <sstream>
 #include "exceptions/insufficient_space_exception.h"
-#include "exceptions/page_not_pinned_exception.h"
 
 using namespace std;
 
@@ -23,7 +22,6 @@ namespace badgerdb
 
 RecordId HeapFileManager::insertTuple(const string &tuple, File &file, BufMgr *bufMgr)
 {
-    Page *nowBufPage;
     PageId nowPageId;
     Page nowPage;
     RecordId recordId;
@@ -33,34 +31,29 @@ RecordId HeapFileManager::insertTuple(const string &tuple, File &file, BufMgr *b
         nowPage = *iter;
         nowPageId = nowPage.page_number();
         if(nowPageId == Page::INVALID_NUMBER) break;
-        bufMgr->readPage(&file, nowPageId, nowBufPage);
+        PageHandle nowBufPage = bufMgr->readPage(&file, nowPageId);
         try
         {
             recordId = nowBufPage->insertRecord(tuple);
-            bufMgr->unPinPage(&file, nowPageId, true);
+            nowBufPage.markDirty();
             return recordId;
         }
-        catch (PageNotPinnedException&)
-        {
-        }
         catch(InsufficientSpaceException&)
         {
-            bufMgr->unPinPage(&file, nowPageId, false);
         }
         ++iter;
     }
-    bufMgr->allocPage(&file, nowPageId, nowBufPage);
+    PageHandle nowBufPage = bufMgr->allocPage(&file, nowPageId);
     recordId = nowBufPage->insertRecord(tuple);
-    bufMgr->unPinPage(&file, nowPageId, true);
+    nowBufPage.markDirty();
   return recordId;
 }
 
 void HeapFileManager::deleteTuple(const RecordId &rid, File &file, BufMgr *bufMgr)
 {
-    Page *page;
-    bufMgr->readPage(&file, rid.page_number, page);
+    PageHandle page = bufMgr->readPage(&file, rid.page_number);
     page->deleteRecord(rid);
-    bufMgr->unPinPage(&file, rid.page_number, true);
+    page.markDirty();
 }
 
 string HeapFileManager::createTupleFromSQLStatement(const string &sql, const Catalog *catalog)
@@ -20,6 +20,11 @@ typedef std::uint32_t PageId;
  */
 typedef std::uint16_t SlotId;
 
+/**
+ * @brief Identifier for a file, unique among the files opened by the process.
+ */
+typedef std::uint32_t FileId;
+
 /**
  * @brief Identifier for a frame in buffer pool.
  */